@@ -17,12 +17,20 @@
 
 #include <QApplication>
 
+#include <huemetrics.h>
+
 #include "mainmenu.h"
 
 int main(int argc, char **argv)
 {
     QApplication app (argc, argv);
 
+    /* opt in, e.g. HUE_QT_METRICS=hue-qt-metrics */
+    QString metrics_socket = qEnvironmentVariable("HUE_QT_METRICS");
+    if (metrics_socket != "") {
+        HueMetrics::instance()->listen(metrics_socket);
+    }
+
     Menu menu;
     menu.show();
 
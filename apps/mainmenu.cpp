@@ -23,13 +23,18 @@
 #include <QSlider>
 #include <QApplication>
 #include <QInputDialog>
+#include <QFileDialog>
+#include <QMessageBox>
 #include <QTimer>
 
 #include <menuswitch.h>
+#include <hueasync.h>
+#include <huetracer.h>
 
 #include "mainmenu.h"
 #include "mainmenubridge.h"
 #include "mainmenusyncbox.h"
+#include "mainmenuhome.h"
 
 Menu::Menu(QWidget *parent): QWidget(parent, Qt::FramelessWindowHint | Qt::WindowSystemMenuHint)
 {
@@ -56,6 +61,13 @@ Menu::Menu(QWidget *parent): QWidget(parent, Qt::FramelessWindowHint | Qt::Windo
     connect(discovery, SIGNAL(bridgeDiscovered(QJsonObject, QString)), this, SLOT(updateSettingMenu()));
     discovery->discoverBridges();
 
+    syncbox_discovery = new HueSyncboxDiscovery();
+    connect(syncbox_discovery, SIGNAL(syncboxDiscovered(QJsonObject, QString)), syncbox_list, SLOT(createSyncbox(QJsonObject, QString)));
+    connect(syncbox_discovery, SIGNAL(syncboxDiscovered(QJsonObject, QString)), this, SLOT(updateSettingMenu()));
+    syncbox_discovery->discoverSyncboxes();
+
+    home = new HueHome(bridge_list, this);
+
     foreach(HueBridge *bridge, bridge_list->list) {
         if (!bridge->known()) {
             bridge->createUser();
@@ -102,10 +114,18 @@ void Menu::addDiscoveredBridge()
 
     HueBridge *bridge =  bridge_list->findBridge(id.toString());
     if (bridge != NULL && !bridge->known()) {
-        bridge->createUser();
+        huePairBridge(bridge);
     }
 }
 
+void Menu::scanNetwork()
+{
+    /* probes every address of the local /24, only on request */
+    discovery->setSubnetScan(true);
+    discovery->discoverBridges();
+    discovery->setSubnetScan(false);
+}
+
 void Menu::addBridgeIP()
 {
     bool ok;
@@ -116,7 +136,26 @@ void Menu::addBridgeIP()
 
     if (ok && !ip_address.isEmpty()) {
         HueBridge *bridge =  bridge_list->addBridge(ip_address);
-        bridge->createUser();
+        huePairBridge(bridge);
+    }
+}
+
+void Menu::addDiscoveredSyncbox()
+{
+    QAction *act = qobject_cast<QAction *>(sender());
+    QVariant id = act->data();
+
+    HueSyncbox *syncbox =  syncbox_list->findSyncbox(id.toString());
+    if (syncbox == NULL || syncbox->known()) {
+        return;
+    }
+
+    QMessageBox::StandardButton ret = QMessageBox::information(0, tr("Add Philips Hue HDMI Syncbox"),
+        tr("After confirmation, hold the Philips Hue HDMI Syncbox button for ~3 seconds (until green blink)."),
+        QMessageBox::Ok | QMessageBox::Cancel);
+
+    if (ret == QMessageBox::Ok) {
+        syncbox->createRegistration();
     }
 }
 
@@ -151,6 +190,21 @@ void Menu::updateSettingMenu()
         }
     }
 
+    foreach(HueSyncbox *syncbox, syncbox_list->list) {
+        if (!syncbox->known()) {
+            QAction *act_unknown_syncbox = new QAction(tr("Add Philips Hue HDMI Syncbox") + " " + syncbox->deviceName(), setting_menu);
+            QVariant id (syncbox->id());
+            act_unknown_syncbox->setData(id);
+
+            connect(act_unknown_syncbox, SIGNAL(triggered()), this, SLOT(addDiscoveredSyncbox()));
+            setting_menu->addAction(act_unknown_syncbox);
+        }
+    }
+
+    QAction *act_scan_network = new QAction(tr("Search local network for Philips Hue Bridges"), setting_menu);
+    connect(act_scan_network, SIGNAL(triggered()), this, SLOT(scanNetwork()));
+    setting_menu->addAction(act_scan_network);
+
     QAction *act_add_bridge_ip = new QAction(tr("Add Philips Hue Bridge with specific IP"), setting_menu);
     connect(act_add_bridge_ip, SIGNAL(triggered()), this, SLOT(addBridgeIP()));
     setting_menu->addAction(act_add_bridge_ip);
@@ -163,6 +217,10 @@ void Menu::updateSettingMenu()
     connect(act_rebuild, SIGNAL(triggered()), this, SLOT(rebuildAll()));
     setting_menu->addAction(act_rebuild);
 
+    QAction *act_export_trace = new QAction(tr("Export command traces"), setting_menu);
+    connect(act_export_trace, SIGNAL(triggered()), this, SLOT(exportTrace()));
+    setting_menu->addAction(act_export_trace);
+
     QAction *act_exit = new QAction(tr("Exit"), setting_menu);
     connect(act_exit, &QAction::triggered, this, &QApplication::quit);
     setting_menu->addAction(act_exit);    
@@ -204,6 +262,19 @@ void Menu::removeDevice()
     }
 }
 
+void Menu::exportTrace()
+{
+    QString path = QFileDialog::getSaveFileName(this, tr("Export command traces"), "hue-qt-trace.json", tr("Chrome trace (*.json)"));
+
+    if (path.isEmpty()) {
+        return;
+    }
+
+    if (!HueTracer::instance()->exportChromeTrace(path)) {
+        QMessageBox::warning(this, tr("Export command traces"), tr("Unable to write the trace file."));
+    }
+}
+
 QWidget* Menu::createDeviceMenu()
 {
     QWidget *device_widget = new QWidget(this);
@@ -214,6 +285,30 @@ QWidget* Menu::createDeviceMenu()
     device_label->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Maximum);
     device_layout->addWidget(device_label);
 
+    int known_bridges = 0;
+    foreach(HueBridge *bridge, bridge_list->list) {
+        if (bridge->known()) {
+            known_bridges++;
+        }
+    }
+
+    // all bridges together, only useful with more than one
+    if (known_bridges > 1) {
+        QPushButton *home_button = new QPushButton();
+        QIcon icon (":images/HueIcons/tabbarHome.svg");
+
+        home_button->setProperty("device_id", "home");
+        home_button->setToolTip(tr("Home"));
+        home_button->setIcon(icon);
+        home_button->setIconSize(QSize(20, 20));
+        home_button->setStyleSheet("QPushButton::menu-indicator {width:0px;} QPushButton {border: none;}");
+
+        connect(home_button, SIGNAL(clicked()), this, SLOT(deviceButtonClicked()));
+
+        device_layout->addWidget(home_button);
+        device_layout->setAlignment(home_button, Qt::AlignRight);
+    }
+
     foreach(HueBridge *bridge, bridge_list->list) {
         if (bridge->known()) {
             QPushButton *bridge_button = new QPushButton();
@@ -295,6 +390,7 @@ void Menu::rebuildAll()
         delete w;
 
     discovery->discoverBridges();
+    syncbox_discovery->discoverSyncboxes();
 
     QVBoxLayout *menu_layout = new QVBoxLayout(this);
 
@@ -304,6 +400,15 @@ void Menu::rebuildAll()
 
     menu_layout->addWidget(createDeviceMenu());
 
+    if (selected_device == "home") {
+        device_label->setText(tr("Home"));
+
+        HomeWidget *home_widget = new HomeWidget(home, this);
+        connect(home_widget, SIGNAL(sizeChanged()), this, SLOT(adjustWindow()));
+
+        menu_layout->addWidget(home_widget);
+    }
+
     HueBridge *bridge = bridge_list->findBridge(selected_device);
     if (bridge != NULL) {
         device_label->setText(bridge->deviceName());
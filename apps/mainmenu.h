@@ -30,6 +30,7 @@
 #include <huebridge.h>
 #include <huesyncboxlist.h>
 #include <huesyncbox.h>
+#include <huehome.h>
 
 #include "mainmenubridge.h"
 
@@ -49,6 +50,8 @@ class Menu : public QWidget
         HueBridgeList *bridge_list;
         HueBridgeDiscovery *discovery;
         HueSyncboxList *syncbox_list;
+        HueSyncboxDiscovery *syncbox_discovery;
+        HueHome *home;
 
         QPushButton *button_settings;
         QString selected_device = "";
@@ -67,11 +70,14 @@ class Menu : public QWidget
         void updateSettingMenu();
         void addDiscoveredBridge();
         void addBridgeIP();
+        void scanNetwork();
+        void addDiscoveredSyncbox();
         void addSyncboxIP();
         void rebuildAll();
         void deviceButtonClicked();
         void deviceContextClicked();
         void removeDevice();
+        void exportTrace();
 };
 
 #endif // MAINMENU_H
\ No newline at end of file
@@ -16,6 +16,9 @@
  */
 
 #include <hueutils.h>
+#include <huejson.h>
+#include <huetracer.h>
+#include <huecommandqueue.h>
 
 #include <menubutton.h>
 #include <menucolorpicker.h>
@@ -27,7 +30,30 @@ BridgeWidget::BridgeWidget(HueBridge *showed_bridge, QWidget *parent): QWidget(p
 {
     bridge = showed_bridge;
     connect(bridge, SIGNAL(statusV2(QJsonObject)), this, SLOT(updateBridge(QJsonObject)));
-    connect(bridge, SIGNAL(events(QJsonArray&)), this, SLOT(processEvents(QJsonArray&)));
+    connect(bridge, SIGNAL(resourceV2(QString, QJsonObject)), this, SLOT(updateResource(QString, QJsonObject)));
+
+    /* scenes too, an edited scene changes its preview */
+    QStringList event_types;
+    event_types << "light" << "scene";
+
+    HueEventSubscription *events = bridge->subscribe(event_types, QStringList(), this);
+    connect(events, SIGNAL(received(HueEvent)), this, SLOT(processEvent(HueEvent)));
+    connect(events, SIGNAL(batchFinished()), this, SLOT(eventsProcessed()));
+
+    connect(bridge, SIGNAL(commandFailed(QString)), this, SLOT(commandFailed(QString)));
+
+    effects = new HueEffects(bridge, this);
+
+    bridge->commands()->setInterval(bridge_delay);
+
+    events_timer = new QTimer(this);
+    events_timer->setSingleShot(true);
+    events_timer->setInterval(events_delay);
+    connect(events_timer, SIGNAL(timeout()), this, SLOT(updateRelatedButtons()));
+
+    pending_timer = new QTimer(this);
+    pending_timer->setInterval(500);
+    connect(pending_timer, SIGNAL(timeout()), this, SLOT(expirePending()));
 
     QVBoxLayout* main_layout = new QVBoxLayout(this);
 
@@ -49,7 +75,11 @@ BridgeWidget::BridgeWidget(HueBridge *showed_bridge, QWidget *parent): QWidget(p
     connect(scenes, SIGNAL(menuToggled()), this, SLOT(autoResize()));
     main_layout->addWidget(scenes);
 
-    bridge->getStatus();
+    for (const QString &type : resource_types) {
+        loading_types.insert(type);
+    }
+
+    bridge->getResources(resource_types);
 }
 
 void BridgeWidget::autoResize()
@@ -100,7 +130,33 @@ void BridgeWidget::sceneClicked()
     json_on["action"] = "active";
     json["recall"] = json_on;
 
-    bridge->putScene(btn->id(), json);
+    HueTraceScope trace(beginTrace("scene", selected_group));
+    QJsonDocument doc(json);
+    bridge->commands()->putScene(btn->id(), doc.toJson(QJsonDocument::Compact), "scene/" + selected_group);
+}
+
+void BridgeWidget::effectClicked()
+{
+    MenuButton *btn = qobject_cast<MenuButton *>(sender());
+    HueEffectTypes type = effect_none;
+
+    if (btn->id() == "effect_color_loop") {
+        type = effect_color_loop;
+    } else if (btn->id() == "effect_candle") {
+        type = effect_candle;
+    } else if (btn->id() == "effect_gradient_chase") {
+        type = effect_gradient_chase;
+    }
+
+    // second click on the running effect stops it
+    if (effects->effect() == type && effect_group == selected_group) {
+        effects->stop();
+        return;
+    }
+
+    effect_group = selected_group;
+    effects->setLights(states_groups[selected_group].light_services.keys());
+    effects->start(type);
 }
 
 void BridgeWidget::removeFromButtonList()
@@ -110,32 +166,192 @@ void BridgeWidget::removeFromButtonList()
     refresh_button_list.remove(btn);
 }
 
-void BridgeWidget::switchId(QString id, bool on)
+bool BridgeWidget::setPending(QString light_id, int fields)
 {
-    QJsonObject json;
+    if (!states_lights.contains(light_id)) {
+        return false;
+    }
 
-    QJsonObject json_on;
-    json_on["on"] = on;
-    json["on"] = json_on;
+    if (!pending_mutations.contains(light_id)) {
+        pending_mutations[light_id].confirmed = states_lights[light_id];
+    }
+
+    PendingMutation &pending = pending_mutations[light_id];
+    pending.fields |= fields;
+
+    markLightDirty(light_id);
+    pending.deadline = QDeadlineTimer(pending_timeout);
+
+    events_update_list.append(light_id);
+
+    if (!pending_timer->isActive()) {
+        pending_timer->start();
+    }
+
+    return true;
+}
+
+void BridgeWidget::reconcilePending(QString light_id, QJsonObject json)
+{
+    PendingMutation &pending = pending_mutations[light_id];
+
+    // the event is the truth, whether it agrees with the command or not
+    pending.confirmed = updateState(pending.confirmed, json);
+
+    if (json.contains("on")) {
+        pending.fields &= ~pending_on;
+    }
+
+    if (json.contains("dimming")) {
+        pending.fields &= ~pending_dimming;
+    }
+
+    if (json.contains("color")) {
+        pending.fields &= ~pending_color;
+    }
+
+    if (json.contains("color_temperature")) {
+        pending.fields &= ~pending_mirek;
+    }
+
+    if (json.contains("gradient")) {
+        pending.fields &= ~pending_gradient;
+    }
+
+    if (pending.fields == 0) {
+        pending_mutations.remove(light_id);
+    }
+}
+
+void BridgeWidget::rollbackPending(QString light_id)
+{
+    if (!pending_mutations.contains(light_id)) {
+        return;
+    }
+
+    states_lights[light_id] = pending_mutations.take(light_id).confirmed;
+    events_update_list.append(light_id);
+    markLightDirty(light_id);
+}
+
+void BridgeWidget::expirePending()
+{
+    QStringList expired;
+
+    QMapIterator<QString, PendingMutation> pending(pending_mutations);
+    while (pending.hasNext()) {
+        pending.next();
+
+        if (pending.value().deadline.hasExpired()) {
+            expired.append(pending.key());
+        }
+    }
+
+    for (const QString &light_id : expired) {
+        rollbackPending(light_id);
+    }
+
+    if (pending_mutations.isEmpty()) {
+        pending_timer->stop();
+    }
+
+    if (!expired.isEmpty()) {
+        updateRelatedButtons();
+    }
+}
+
+void BridgeWidget::commandFailed(QString id)
+{
+    QStringList light_ids;
+
+    if (pending_mutations.contains(id)) {
+        light_ids.append(id);
+    }
+
+    // a grouped_light command set the pending state of its member lights
+    for (const ItemState &group : std::as_const(states_groups)) {
+        if (group.grouped_light_rid != id) {
+            continue;
+        }
+
+        QMapIterator<QString, QString> service(group.light_services);
+        while (service.hasNext()) {
+            service.next();
+
+            if (service.value() == "light" && pending_mutations.contains(service.key())) {
+                light_ids.append(service.key());
+            }
+        }
+    }
+
+    // scenes and effects leave no pending state behind
+    if (light_ids.isEmpty()) {
+        return;
+    }
+
+    for (const QString &light_id : light_ids) {
+        rollbackPending(light_id);
+    }
+
+    if (pending_mutations.isEmpty()) {
+        pending_timer->stop();
+    }
+
+    updateRelatedButtons();
+}
+
+quint64 BridgeWidget::beginTrace(QString name, QString id)
+{
+    QStringList targets;
 
     if (states_groups.contains(id)) {
-        bridge->putGroupedLight(states_groups[id].grouped_light_rid, json);
+        QMapIterator<QString, QString> service(states_groups[id].light_services);
+        while (service.hasNext()) {
+            service.next();
+
+            if (service.value() == "light") {
+                targets.append(service.key());
+            }
+        }
     } else {
-        bridge->putLight(id, json);
+        targets.append(id);
     }
+
+    return HueTracer::instance()->begin(name + " " + id, targets);
 }
 
-void BridgeWidget::dimmId(QString id, int value)
+void BridgeWidget::switchId(QString id, bool on)
 {
-    QJsonObject json;
+    QByteArray json = hueOnBody(on);
+    HueTraceScope trace(beginTrace("switch", id));
 
-    QJsonObject json_on;
-    json_on["on"] = true;
-    json["on"] = json_on;
+    if (states_groups.contains(id)) {
+        QMapIterator<QString, QString> service(states_groups[id].light_services);
+        while (service.hasNext()) {
+            service.next();
 
-    QJsonObject json_brightness;
-    json_brightness["brightness"] = value;
-    json["dimming"] = json_brightness;
+            if (service.value() == "light" && setPending(service.key(), pending_on)) {
+                states_lights[service.key()].on = on;
+            }
+        }
+
+        QString grouped_light_rid = states_groups[id].grouped_light_rid;
+        bridge->commands()->putGroupedLight(grouped_light_rid, json, "on/" + grouped_light_rid);
+    } else {
+        if (setPending(id, pending_on)) {
+            states_lights[id].on = on;
+        }
+
+        bridge->commands()->putLight(id, json, "on/" + id);
+    }
+
+    updateRelatedButtons();
+}
+
+void BridgeWidget::dimmId(QString id, int value)
+{
+    QByteArray json = hueDimmingBody(value);
+    HueTraceScope trace(beginTrace("dimm", id));
 
     if (states_groups.contains(id)) {
         bool any_on = checkAnyServiceIsOn(states_groups[id].light_services, "light");
@@ -145,27 +361,40 @@ void BridgeWidget::dimmId(QString id, int value)
             service.next();
 
             if (service.value() == "light" && (states_lights[service.key()].on || !any_on)) {
-                delay(bridge_delay);
-                bridge->putLight(service.key(), json);
+                if (setPending(service.key(), pending_on | pending_dimming)) {
+                    states_lights[service.key()].on = true;
+                    states_lights[service.key()].brightness = value;
+                }
+
+                bridge->commands()->putLight(service.key(), json, "dimming/" + service.key());
             }
         }
 
         // the bridge does not allow to change the brightness of group yet
         // bridge->putGroupedLight(states_groups[id].grouped_light_rid, json);
     } else {
-        bridge->putLight(id, json);
+        if (setPending(id, pending_on | pending_dimming)) {
+            states_lights[id].on = true;
+            states_lights[id].brightness = value;
+        }
+
+        bridge->commands()->putLight(id, json, "dimming/" + id);
     }
+
+    updateRelatedButtons();
 }
 
 void BridgeWidget::changeColorGradient(QString id, QColor color)
 {
-    QJsonObject json;
     int gradient_point;
-    ItemState state;
 
-    state = states_lights[id];
+    if (!states_lights.contains(id)) {
+        return;
+    }
 
-    if (!state.has_gradient) {
+    ItemState &state = states_lights[id];
+
+    if (!state.has_gradient || state.gradient_points_capable <= 0) {
         return;
     }
 
@@ -175,57 +404,37 @@ void BridgeWidget::changeColorGradient(QString id, QColor color)
 
     gradient_point = cpck->property("gradient_point").toInt();
 
-    QJsonObject json_on;
-    json_on["on"] = true;
-    json["on"] = json_on;
-
-    QJsonObject json_gradient;
-    QJsonArray points_array;
-    for (int i = 0; i < state.gradient_points_capable; ++i) {
-        QVarLengthArray<float> tmp_xy;
-
-        if (gradient_point == i) {
-            tmp_xy = xy;
-        } else if (state.gradient_points.length() != state.gradient_points_capable) {
-            tmp_xy = xy;
-        } else {
-            tmp_xy = colorToHueXY(state.gradient_points[i]);
-        }
-
-        QJsonObject json_xy;
-        json_xy["x"] = tmp_xy[0];
-        json_xy["y"] = tmp_xy[1];
+    HueTraceScope trace(beginTrace("gradient", id));
 
-        QJsonObject json_color_xy;
-        json_color_xy["xy"] = json_xy;
+    setPending(id, pending_on | pending_gradient);
+    state.on = true;
 
-        QJsonObject json_color;
-        json_color["color"] = json_color_xy;
+    if (state.gradient_xy.size() != state.gradient_points_capable * 2) {
+        // unknown points yet, the whole strip gets the picked color
+        state.gradient_xy.clear();
+        state.gradient_points.clear();
 
-        points_array.append(json_color);
+        for (int i = 0; i < state.gradient_points_capable; ++i) {
+            state.gradient_xy.append(xy[0]);
+            state.gradient_xy.append(xy[1]);
+            state.gradient_points.append(color);
+        }
+    } else if (gradient_point >= 0 && gradient_point < state.gradient_points_capable) {
+        state.gradient_xy[gradient_point * 2] = xy[0];
+        state.gradient_xy[gradient_point * 2 + 1] = xy[1];
+        state.gradient_points[gradient_point] = color;
     }
-    json_gradient["points"] = points_array;
-    json["gradient"] = json_gradient;
 
-    bridge->putLight(id, json);
+    bridge->commands()->putLight(id, hueGradientBody(state.gradient_xy.constData(), state.gradient_points_capable), "gradient/" + id);
+
+    updateRelatedButtons();
 }
 
 void BridgeWidget::changeColor(QString id, QColor color)
 {
-    QJsonObject json;
     QVarLengthArray<float> xy = colorToHueXY(color);
-
-    QJsonObject json_on;
-    json_on["on"] = true;
-    json["on"] = json_on;
-
-    QJsonObject json_xy;
-    json_xy["x"] = xy[0];
-    json_xy["y"] = xy[1];
-
-    QJsonObject json_color;
-    json_color["xy"] = json_xy;
-    json["color"] = json_color;
+    QByteArray json = hueColorBody(xy[0], xy[1]);
+    HueTraceScope trace(beginTrace("color", id));
 
     if (states_groups.contains(id)) {
         bool any_on = checkAnyServiceIsOn(states_groups[id].light_services, "light");
@@ -235,29 +444,34 @@ void BridgeWidget::changeColor(QString id, QColor color)
             service.next();
 
             if (service.value() == "light" && (states_lights[service.key()].on || !any_on)) {
-                delay(bridge_delay);
-                bridge->putLight(service.key(), json);
+                if (setPending(service.key(), pending_on | pending_color)) {
+                    states_lights[service.key()].on = true;
+                    states_lights[service.key()].color = color;
+                }
+
+                bridge->commands()->putLight(service.key(), json, "color/" + service.key());
             }
         }
 
         // the bridge does not allow to change the brightness of group yet
         // bridge->putGroupedLight(states_groups[id].grouped_light_rid, json);
     } else {
-        bridge->putLight(id, json);
+        if (setPending(id, pending_on | pending_color)) {
+            states_lights[id].on = true;
+            states_lights[id].color = color;
+        }
+
+        bridge->commands()->putLight(id, json, "color/" + id);
     }
+
+    updateRelatedButtons();
 }
 
 void BridgeWidget::changeMirek(QString id, int mirek)
 {
-    QJsonObject json;
-
-    QJsonObject json_on;
-    json_on["on"] = true;
-    json["on"] = json_on;
-
-    QJsonObject json_mirek;
-    json_mirek["mirek"] = mirek;
-    json["color_temperature"] = json_mirek;
+    QByteArray json = hueMirekBody(mirek);
+    QColor mirek_color = kelvinToColor(mirekToKelvin(mirek));
+    HueTraceScope trace(beginTrace("mirek", id));
 
     if (states_groups.contains(id)) {
         bool any_on = checkAnyServiceIsOn(states_groups[id].light_services, "light");
@@ -267,16 +481,33 @@ void BridgeWidget::changeMirek(QString id, int mirek)
             service.next();
 
             if (service.value() == "light" && (states_lights[service.key()].on || !any_on)) {
-                delay(bridge_delay);
-                bridge->putLight(service.key(), json);
+                if (setPending(service.key(), pending_on | pending_mirek)) {
+                    ItemState &state = states_lights[service.key()];
+                    state.on = true;
+                    state.mirek_temperature = mirek;
+                    state.mirek_color = mirek_color;
+                    state.color = mirek_color;
+                }
+
+                bridge->commands()->putLight(service.key(), json, "color/" + service.key());
             }
         }
 
         // the bridge does not allow to change the brightness of group yet
         // bridge->putGroupedLight(states_groups[id].grouped_light_rid, json);
     } else {
-        bridge->putLight(id, json);
+        if (setPending(id, pending_on | pending_mirek)) {
+            ItemState &state = states_lights[id];
+            state.on = true;
+            state.mirek_temperature = mirek;
+            state.mirek_color = mirek_color;
+            state.color = mirek_color;
+        }
+
+        bridge->commands()->putLight(id, json, "color/" + id);
     }
+
+    updateRelatedButtons();
 }
 
 void BridgeWidget::gradientSelected(QString id, int point)
@@ -349,7 +580,7 @@ QMap<QString, ItemState>* BridgeWidget::getStatesByType(QString type)
     if (type == "bridge_home")
         return &states_groups;
 
-    else if (type == "devices")
+    else if (type == "device")
         return &states_devices;
 
     else if (type == "room")
@@ -367,22 +598,10 @@ QMap<QString, ItemState>* BridgeWidget::getStatesByType(QString type)
     return NULL;
 }
 
-void BridgeWidget::createStates(QJsonObject json)
+void BridgeWidget::addResourceStates(QJsonArray json_array)
 {
-    QJsonObject json_item;
     QString type;
 
-    states_devices.clear();
-    states_groups.clear();
-    states_lights.clear();
-    states_scenes.clear();
-
-    if (! json.contains("data")) {
-        return;
-    }
-
-    QJsonArray json_array = json["data"].toArray();
-
     for (int i = 0; i < json_array.size(); ++i) {
         QJsonObject json_item = json_array[i].toObject();
 
@@ -410,7 +629,10 @@ void BridgeWidget::createStates(QJsonObject json)
         else if (type == "scene")
             addSceneState(json_item);
     }
+}
 
+void BridgeWidget::linkStates()
+{
     QMapIterator<QString, ItemState> group(states_groups);
 
     while (group.hasNext()) {
@@ -420,6 +642,79 @@ void BridgeWidget::createStates(QJsonObject json)
             states_groups[id].light_services = getLightServicesByGroup(id);
     }
 
+    rebuildGroupSums();
+    updateScenePalettes();
+}
+
+void BridgeWidget::updateScenePalette(ItemState &state)
+{
+    ScenePalette &palette = scene_palettes[state.id];
+
+    /* the hash only tells an edited scene apart, the cache is keyed by its id */
+    if (palette.version != state.scene_version || palette.colors.isEmpty()) {
+        palette.version = state.scene_version;
+        palette.colors = scenePalette(state.scene_actions);
+    }
+
+    state.scene_palette = palette.colors;
+}
+
+void BridgeWidget::updateScenePalettes()
+{
+    QHash<QString, ScenePalette> used;
+
+    /* computed once per fetch, scenes no longer present are dropped */
+    QMutableMapIterator<QString, ItemState> scene(states_scenes);
+    while (scene.hasNext()) {
+        scene.next();
+
+        updateScenePalette(scene.value());
+        used.insert(scene.key(), scene_palettes.value(scene.key()));
+    }
+
+    scene_palettes = used;
+}
+
+void BridgeWidget::createStates(QJsonObject json)
+{
+    states_devices.clear();
+    states_groups.clear();
+    states_lights.clear();
+    states_scenes.clear();
+    pending_mutations.clear();
+
+    if (! json.contains("data")) {
+        return;
+    }
+
+    addResourceStates(json["data"].toArray());
+    linkStates();
+}
+
+void BridgeWidget::mergeStates(QString type, QJsonObject json)
+{
+    QMap<QString, ItemState> *states = getStatesByType(type);
+
+    if (states == NULL || ! json.contains("data")) {
+        return;
+    }
+
+    /* the home, rooms and zones share one map, replace only this type */
+    QMutableMapIterator<QString, ItemState> i(*states);
+    while (i.hasNext()) {
+        i.next();
+
+        if (i.value().type == type) {
+            i.remove();
+        }
+    }
+
+    if (type == "light") {
+        pending_mutations.clear();
+    }
+
+    addResourceStates(json["data"].toArray());
+    linkStates();
 }
 
 void BridgeWidget::updateButtonState(MenuButton* button, ItemState state)
@@ -465,6 +760,10 @@ void BridgeWidget::updateButtonState(MenuButton* button, ItemState state)
         button->setColor(off_color);
     }
 
+    if (state.type == "scene") {
+        button->setPreviewColors(state.scene_palette);
+    }
+
     if (state.has_gradient && state.gradient_points_capable > 0) {
         if (!is_on || state.gradient_points.length() == 0) {
             QVarLengthArray<QColor> gradient_points;
@@ -634,27 +933,73 @@ bool BridgeWidget::checkAllServicesAreOn(QMapIterator<QString, QString> services
 
 ItemState BridgeWidget::getCombinedGroupState(ItemState base_state)
 {
-    ItemState state = base_state;
-    QString id;
-    QString type;
+    flushDirtyLights();
 
-    QMapIterator<QString, QString> service(state.light_services);
-    while (service.hasNext()) {
-        service.next();
+    if (!group_sums.contains(base_state.id)) {
+        return base_state;
+    }
 
-        id = service.key();
-        type = service.value();
+    return combinedState(base_state, group_sums[base_state.id]);
+}
+
+void BridgeWidget::rebuildGroupSums()
+{
+    group_sums.clear();
+    light_sums.clear();
+    light_groups.clear();
+    dirty_lights.clear();
+
+    QMapIterator<QString, ItemState> light(states_lights);
+    while (light.hasNext()) {
+        light.next();
 
-        if (type != "light") {
+        light_sums[light.key()] = stateContribution(light.value());
+    }
+
+    QMapIterator<QString, ItemState> group(states_groups);
+    while (group.hasNext()) {
+        group.next();
+
+        StateSums &sums = group_sums[group.key()];
+
+        QMapIterator<QString, QString> service(group.value().light_services);
+        while (service.hasNext()) {
+            service.next();
+
+            if (service.value() != "light" || !light_sums.contains(service.key())) {
+                continue;
+            }
+
+            light_groups.insert(service.key(), group.key());
+            addStateSums(sums, light_sums[service.key()], 1);
+        }
+    }
+}
+
+void BridgeWidget::markLightDirty(QString light_id)
+{
+    dirty_lights.insert(light_id);
+}
+
+void BridgeWidget::flushDirtyLights()
+{
+    for (const QString &light_id : dirty_lights) {
+        if (!light_sums.contains(light_id)) {
             continue;
         }
 
-        state = combineTwoStates(state, states_lights[id]);
-    }
+        StateSums previous = light_sums[light_id];
+        StateSums current = stateContribution(states_lights.value(light_id));
 
-    state.light_services = base_state.light_services;
+        for (const QString &group_id : light_groups.values(light_id)) {
+            addStateSums(group_sums[group_id], previous, -1);
+            addStateSums(group_sums[group_id], current, 1);
+        }
 
-    return state;
+        light_sums[light_id] = current;
+    }
+
+    dirty_lights.clear();
 }
 
 void BridgeWidget::setGroups()
@@ -908,6 +1253,25 @@ void BridgeWidget::setScenes(QString group_id)
         counter++;
     }
 
+    if (!states_groups[group_id].light_services.isEmpty()) {
+        const QList<QStringList> effect_buttons = {
+            {"effect_color_loop", tr("Color loop"), ":images/HueIcons/uicontrolsColorloop.svg"},
+            {"effect_candle", tr("Candle"), ":images/HueIcons/otherFire.svg"},
+            {"effect_gradient_chase", tr("Gradient chase"), ":images/HueIcons/uicontrolsColorScenes.svg"}
+        };
+
+        for (const QStringList &effect : effect_buttons) {
+            state = ItemState();
+            state.dummy = true;
+            state.id = effect[0];
+
+            button = createMenuButton(scenes, state, &BridgeWidget::effectClicked, false, effect[1], effect[2]);
+            scenes->addContentMenuButton(*button);
+
+            counter++;
+        }
+    }
+
     if (counter == 0) {
         scenes->setVisible(false);
     } else {
@@ -938,10 +1302,8 @@ void BridgeWidget::updateAllButtons()
     }
 }
 
-void BridgeWidget::updateBridge(QJsonObject json)
+void BridgeWidget::renderStates()
 {
-    createStates(json);
-
     if (selected_group == "") {
         selected_group = bridge_home_id;
     }
@@ -952,15 +1314,44 @@ void BridgeWidget::updateBridge(QJsonObject json)
         setColorsTemperature(selected_light, selected_group);
         setScenes(selected_group);
 
-        groups->toggle(true);
-        lights->toggle(false);
-        colors->toggle(false);
-        scenes->toggle(false);
+        if (! rendered) {
+            groups->toggle(true);
+            lights->toggle(false);
+            colors->toggle(false);
+            scenes->toggle(false);
+        }
     } else {
         updateAllButtons();
     }
 
-    rebuild = false;
+    rendered = true;
+
+    /* buttons are recreated until every requested type has arrived */
+    rebuild = ! loading_types.isEmpty();
+}
+
+void BridgeWidget::updateBridge(QJsonObject json)
+{
+    createStates(json);
+
+    loading_types.clear();
+    renderStates();
+}
+
+void BridgeWidget::updateResource(QString type, QJsonObject json)
+{
+    if (!resource_types.contains(type)) {
+        return; // single resources asked by someone else
+    }
+
+    loading_types.remove(type);
+    mergeStates(type, json);
+
+    if (bridge_home_id == "") {
+        return; // groups are listed below the home, wait for it
+    }
+
+    renderStates();
 }
 
 QString BridgeWidget::updateStateByEvent(QJsonObject json)
@@ -982,8 +1373,16 @@ QString BridgeWidget::updateStateByEvent(QJsonObject json)
 
     state = updateState(state, json);
 
+    if (type == "scene") {
+        updateScenePalette(state);
+    }
+
     (*states)[id] = state;
 
+    if (type == "light") {
+        markLightDirty(id);
+    }
+
     return id;
 }
 
@@ -1034,39 +1433,27 @@ void BridgeWidget::updateRelatedButtons()
     waiting_events = false;
 }
 
-void BridgeWidget::processEvents(QJsonArray &json_array)
+void BridgeWidget::processEvent(const HueEvent &event)
 {
-    QJsonObject json;
     QString updated;
 
-    for (int i = 0; i < json_array.size(); ++i) {
-        json = json_array[i].toObject();
-
-        if (! json.contains("data")) {
-            continue;
-        }
-
-        if (json["type"].toString() != "update") {
-            continue;
-        }
+    if (event.event != event_update) {
+        return;
+    }
 
-        QJsonArray json_event_array = json["data"].toArray();
-        for (int j = 0; j < json_event_array.size(); ++j) {
-            QJsonObject json_event = json_event_array[j].toObject();
+    updated = updateStateByEvent(event.data);
+    events_update_list.append(updated);
+    HueTracer::instance()->resourceUpdated(updated);
 
-            if (json_event["type"].toString() == "light") {
-                updated = updateStateByEvent(json_event);
-                events_update_list.append(updated);
-            }
-        }
+    if (pending_mutations.contains(updated)) {
+        reconcilePending(updated, event.data);
     }
+}
 
+void BridgeWidget::eventsProcessed()
+{
     if (waiting_events == false) {
-        TimerThread *timer = new TimerThread();
-        connect(timer, &TimerThread::timeIsUp, this, &BridgeWidget::updateRelatedButtons );
-        connect(timer, &TimerThread::finished, timer, &QObject::deleteLater);
-        timer->setDelay(1200);
-        timer->start();
+        events_timer->start();
     }
 
     waiting_events = true;
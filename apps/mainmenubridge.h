@@ -20,8 +20,12 @@
 
 #include <QWidget>
 #include <QMap>
+#include <QTimer>
+#include <QSet>
+#include <QHash>
 
 #include <huebridge.h>
+#include <hueeffects.h>
 #include <menuexpendable.h>
 
 #include "mainmenubridgeutils.h"
@@ -127,24 +131,52 @@ class BridgeWidget : public QWidget
         MenuExpendable* lights;
         MenuExpendable* scenes;
         MenuExpendable* colors;
+        HueEffects* effects;
+        QString effect_group = "";
         bool rebuild = true;
+        bool rendered = false;
+
+        /* fetched per type, the small group lists land first */
+        const QStringList resource_types = {"bridge_home", "room", "zone", "device", "light", "scene"};
+        QSet<QString> loading_types;
 
         QMap<QString, ItemState> states_devices;
         QMap<QString, ItemState> states_groups;
         QMap<QString, ItemState> states_lights;
         QMap<QString, ItemState> states_scenes;
 
+        /* preview colors per scene id, recomputed when the scene version changes */
+        QHash<QString, ScenePalette> scene_palettes;
+
+        /* combined group states, updated only for lights marked dirty */
+        QMap<QString, StateSums> group_sums;
+        QMap<QString, StateSums> light_sums;
+        QMultiMap<QString, QString> light_groups; // <light rid, group id>
+        QSet<QString> dirty_lights;
+
         QVarLengthArray<QString> events_update_list;
         bool waiting_events = false;
+        QTimer *events_timer;
+        const int events_delay = 1200;
         QMap<MenuButton*, QString> refresh_button_list;
 
         const int bridge_delay = 150;
 
+        QMap<QString, PendingMutation> pending_mutations;
+        QTimer *pending_timer;
+        const int pending_timeout = 3000;
+
         void addDeviceState(QJsonObject json);
         void addGroupState(QJsonObject json);
         void addLightState(QJsonObject json);
         void addSceneState(QJsonObject json);
+        void addResourceStates(QJsonArray json_array);
+        void linkStates();
+        void updateScenePalette(ItemState &state);
+        void updateScenePalettes();
         void createStates(QJsonObject json);
+        void mergeStates(QString type, QJsonObject json);
+        void renderStates();
         QMap<QString, ItemState>* getStatesByType(QString type);
 
         void updateButtonState(MenuButton* button, ItemState state);
@@ -164,6 +196,9 @@ class BridgeWidget : public QWidget
         bool checkAllServicesAreOn(QMapIterator<QString, QString> services, QString type);
 
         ItemState getCombinedGroupState(ItemState base_state);
+        void rebuildGroupSums();
+        void markLightDirty(QString light_id);
+        void flushDirtyLights();
 
         void setGroups();
         void setLights(QString group_id);
@@ -173,15 +208,26 @@ class BridgeWidget : public QWidget
         void updateAllButtons();
         QString updateStateByEvent(QJsonObject json);
 
+        quint64 beginTrace(QString name, QString id);
+
+        bool setPending(QString light_id, int fields);
+        void reconcilePending(QString light_id, QJsonObject json);
+        void rollbackPending(QString light_id);
+
     private slots:
         void updateBridge(QJsonObject json);
+        void updateResource(QString type, QJsonObject json);
         void updateRelatedButtons();
-        void processEvents(QJsonArray &json_array);
+        void processEvent(const HueEvent &event);
+        void eventsProcessed();
         void autoResize();
         void groupClicked();
         void lightClicked();
         void sceneClicked();
+        void effectClicked();
         void removeFromButtonList();
+        void expirePending();
+        void commandFailed(QString id);
 
         void switchId(QString id, bool on);
         void dimmId(QString id, int value);
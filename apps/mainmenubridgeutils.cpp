@@ -15,6 +15,8 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <hueutils.h>
+
 #include "mainmenubridgeutils.h"
 
 ItemState getLightFromJson(QJsonObject json)
@@ -110,6 +112,7 @@ ItemState updateState(ItemState state, QJsonObject json)
 
         QJsonArray gradient_points_array = json["gradient"].toObject()["points"].toArray();
 
+        state.gradient_xy.clear();
         state.gradient_points.clear();
 
         if (gradient_points_array.size() == state.gradient_points_capable) {
@@ -117,6 +120,9 @@ ItemState updateState(ItemState state, QJsonObject json)
                 x = gradient_points_array[i].toObject()["color"].toObject()["xy"].toObject()["x"].toDouble();
                 y = gradient_points_array[i].toObject()["color"].toObject()["xy"].toObject()["y"].toDouble();
 
+                state.gradient_xy.append(x);
+                state.gradient_xy.append(y);
+
                 QColor gradient_point = XYBriToColor(x, y, 255);
                 state.gradient_points.append(gradient_point);
             }
@@ -150,9 +156,91 @@ ItemState updateState(ItemState state, QJsonObject json)
         state.group_type = json["group"].toObject()["rtype"].toString();
     }
 
+    if (json.contains("actions")) {
+        QJsonArray actions = json["actions"].toArray();
+
+        state.scene_actions.clear();
+        state.scene_version = qHash(QJsonDocument(actions).toJson(QJsonDocument::Compact));
+
+        for (int i = 0; i < actions.size(); ++i) {
+            QJsonObject json_action = actions[i].toObject();
+            QJsonObject action = json_action["action"].toObject();
+            SceneAction scene_action;
+
+            scene_action.light_rid = json_action["target"].toObject()["rid"].toString();
+
+            if (action.contains("on")) {
+                scene_action.on = action["on"].toObject()["on"].toBool();
+            }
+
+            if (action.contains("color")) {
+                scene_action.has_xy = true;
+                scene_action.x = action["color"].toObject()["xy"].toObject()["x"].toDouble();
+                scene_action.y = action["color"].toObject()["xy"].toObject()["y"].toDouble();
+            }
+
+            if (action.contains("color_temperature")) {
+                scene_action.has_mirek = true;
+                scene_action.mirek = action["color_temperature"].toObject()["mirek"].toDouble();
+            }
+
+            if (action.contains("dimming")) {
+                scene_action.has_dimming = true;
+                scene_action.brightness = action["dimming"].toObject()["brightness"].toDouble();
+            }
+
+            state.scene_actions.append(scene_action);
+        }
+    }
+
     return state;
 }
 
+QVarLengthArray<QColor> scenePalette(const QVarLengthArray<SceneAction, 8> &actions, int max_colors)
+{
+    QVarLengthArray<QColor> palette;
+
+    for (const SceneAction &action : actions) {
+        QColor color;
+        bool similar = false;
+
+        if (!action.on) {
+            continue;
+        }
+
+        if (action.has_xy) {
+            color = XYBriToColor(action.x, action.y, 255);
+        } else if (action.has_mirek && action.mirek > 0) {
+            color = kelvinToColor(mirekToKelvin(action.mirek));
+        } else {
+            continue;
+        }
+
+        /* dimmed lights look darker, but never so dark the dot disappears */
+        color = color.darker(100 + (100 - qBound(0, int(action.brightness), 100)) / 2);
+
+        /* many lights of a scene share a color, keep only distinct ones */
+        for (const QColor &known : palette) {
+            if (qAbs(known.red() - color.red()) + qAbs(known.green() - color.green()) + qAbs(known.blue() - color.blue()) < 48) {
+                similar = true;
+                break;
+            }
+        }
+
+        if (similar) {
+            continue;
+        }
+
+        palette.append(color);
+
+        if (palette.size() >= max_colors) {
+            break;
+        }
+    }
+
+    return palette;
+}
+
 bool colorIsBlack(QColor color)
 {
     if (color.red() == 255 && color.green() == 255 && color.blue() == 255) {
@@ -162,114 +250,114 @@ bool colorIsBlack(QColor color)
     return false;
 }
 
-QColor combineTwoColors(QColor base, QColor joiner)
+StateSums stateContribution(const ItemState &light)
 {
-    double red  = (base.red() + joiner.red()) / 2.0;
-    double green  = (base.green() + joiner.green()) / 2.0;
-    double blue  = (base.blue() + joiner.blue()) / 2.0;
-    double alpha  = (base.alpha() + joiner.alpha()) / 2.0;
-
-    return QColor::fromRgb(red, green, blue, alpha);
-}
+    StateSums sums;
+    QColor color;
+
+    sums.members = 1;
+    sums.has_on = light.has_on;
+    sums.on = light.has_on && light.on;
+    sums.has_dimming = light.has_dimming;
+    sums.has_color = light.has_color;
+    sums.has_mirek = light.has_mirek;
+
+    if (light.has_mirek) {
+        sums.mirek_min = light.mirek_min;
+        sums.mirek_max = light.mirek_max;
+    }
 
+    // only lights which are on give the group its look
+    if (!sums.on) {
+        return sums;
+    }
 
-// my wish is this function would work forever and nobody will need to read it, sorry:-)
-ItemState combineTwoStates(ItemState base, ItemState joiner)
-{
-    ItemState state;
+    if (light.has_dimming && light.brightness != 0) {
+        sums.brightness_count = 1;
+        sums.brightness = light.brightness;
+    }
 
-    state.id = base.id;
-    state.type = base.type;
-    state.name = base.name;
-    state.archetype = base.archetype;
+    if (light.has_color && !colorIsBlack(light.color)) {
+        color = light.color;
+    } else if (light.has_mirek && !colorIsBlack(light.mirek_color)) {
+        color = light.mirek_color;
+    }
 
-    state.has_on = base.has_on || joiner.has_on;
-    state.on = base.on || joiner.on;
+    if (color.isValid()) {
+        sums.color_count = 1;
+        sums.red = color.red();
+        sums.green = color.green();
+        sums.blue = color.blue();
+    }
 
-    if (! state.has_on) {
-        return state;
+    if (light.has_mirek && light.mirek_temperature != 0) {
+        sums.mirek_count = 1;
+        sums.mirek = light.mirek_temperature;
     }
 
-    state.has_dimming = base.has_dimming || joiner.has_dimming;
-    if ((base.on && joiner.on) && base.has_dimming && joiner.has_dimming && base.brightness != 0 && joiner.brightness != 0) {
-        state.brightness = (base.brightness + joiner.brightness) / 2.0;
-    } else if (base.on && base.has_dimming && base.brightness != 0) {
-        state.brightness = base.brightness;
-    } else if (joiner.on && joiner.has_dimming && joiner.brightness != 0) {
-        state.brightness = joiner.brightness;
+    return sums;
+}
+
+void addStateSums(StateSums &sums, const StateSums &light, int sign)
+{
+    // mirek schemas do not change at runtime, the range only widens
+    if (sign > 0 && light.has_mirek) {
+        sums.mirek_min = sums.has_mirek == 0 ? light.mirek_min : qMin(sums.mirek_min, light.mirek_min);
+        sums.mirek_max = sums.has_mirek == 0 ? light.mirek_max : qMax(sums.mirek_max, light.mirek_max);
     }
 
-    state.has_color = base.has_color || joiner.has_color;
-    if ((base.on && joiner.on) && base.has_color && joiner.has_color && !colorIsBlack(base.color) && !colorIsBlack(joiner.color)) {
+    sums.members += sign * light.members;
+    sums.has_on += sign * light.has_on;
+    sums.on += sign * light.on;
+    sums.has_dimming += sign * light.has_dimming;
+    sums.has_color += sign * light.has_color;
+    sums.has_mirek += sign * light.has_mirek;
 
-        state.color = combineTwoColors(base.color, joiner.color);
+    sums.brightness_count += sign * light.brightness_count;
+    sums.brightness += sign * light.brightness;
 
-    } else if (base.on && base.has_color && !colorIsBlack(base.color)) {
-        state.color = base.color;
-    } else if (joiner.on && joiner.has_color && !colorIsBlack(joiner.color)) {
-        state.color = joiner.color;
-    }
+    sums.color_count += sign * light.color_count;
+    sums.red += sign * light.red;
+    sums.green += sign * light.green;
+    sums.blue += sign * light.blue;
 
-    state.has_mirek = base.has_mirek || joiner.has_mirek;
-    if ((base.on && joiner.on) && base.has_mirek && joiner.has_mirek) {
-        if (base.mirek_temperature != 0 && joiner.mirek_temperature != 0) {
-            state.mirek_temperature = (base.mirek_temperature + joiner.mirek_temperature) / 2.0;
-        } else if (base.mirek_temperature != 0) {
-            state.mirek_temperature = base.mirek_temperature;
-        } else if (joiner.mirek_temperature != 0) {
-            state.mirek_temperature = joiner.mirek_temperature;
-        }
+    sums.mirek_count += sign * light.mirek_count;
+    sums.mirek += sign * light.mirek;
+}
 
-        state.mirek_min = qMin(base.mirek_min, joiner.mirek_min);
-        state.mirek_max = qMax(base.mirek_max, joiner.mirek_max);
-    } else if (base.on && base.has_mirek) {
-        state.mirek_min = base.mirek_min;
-        state.mirek_max = base.mirek_max;
-    } else if (joiner.on && joiner.has_mirek) {
-        state.mirek_min = joiner.mirek_min;
-        state.mirek_max = joiner.mirek_max;
-    }
+ItemState combinedState(ItemState base, const StateSums &sums)
+{
+    ItemState state = base;
 
-    // we need to combine mirek color and ordinary color
-    if (! base.has_color && ! joiner.has_color && joiner.has_color && !colorIsBlack(base.color) && !colorIsBlack(joiner.color)) {
-        if (base.on && base.has_mirek && joiner.on && joiner.has_mirek) {
-            state.color = combineTwoColors(base.mirek_color, joiner.mirek_color);
-            state.has_color = true;
-        } else if (base.on && base.has_mirek && (!joiner.has_mirek || !joiner.on) && !colorIsBlack(base.color)) {
-            state.color = base.mirek_color;
-            state.has_color = true;
-        } else if ((!base.has_mirek || !base.on)&& joiner.on && joiner.has_mirek && !colorIsBlack(joiner.color)) {
-            state.color = joiner.mirek_color;
-            state.has_color = true;
-        }
-    }
-    if (base.on && base.has_color && joiner.on && ! joiner.has_color && joiner.has_mirek && !colorIsBlack(base.color) && !colorIsBlack(joiner.mirek_color)) {
-        state.color = combineTwoColors(base.color, joiner.mirek_color);
-        state.has_color = true;
-    }
-    if (joiner.on && joiner.has_color && base.on && ! base.has_color && base.has_mirek && !colorIsBlack(base.mirek_color) && !colorIsBlack(joiner.color)) {
-        state.color = combineTwoColors(joiner.color, base.mirek_color);
-        state.has_color = true;
+    state.has_on = sums.has_on > 0;
+    state.on = sums.on > 0;
+
+    state.has_dimming = sums.has_dimming > 0;
+    state.brightness = 0;
+    if (sums.brightness_count > 0) {
+        state.brightness = qRound(sums.brightness / sums.brightness_count);
     }
-    if (base.on && !joiner.on && base.has_mirek && ! base.has_color && !colorIsBlack(base.mirek_color)) {
-        state.color = base.mirek_color;
-        state.has_color = true;
+
+    state.has_color = sums.has_color > 0 || sums.color_count > 0;
+    state.color = QColor(255, 255, 255);
+    if (sums.color_count > 0) {
+        state.color = QColor::fromRgb(
+            qRound(sums.red / sums.color_count),
+            qRound(sums.green / sums.color_count),
+            qRound(sums.blue / sums.color_count));
     }
-    if (joiner.on && !base.on && joiner.has_mirek && ! joiner.has_color && !colorIsBlack(joiner.mirek_color)) {
-        state.color = joiner.mirek_color;
-        state.has_color = true;
+
+    state.has_mirek = sums.has_mirek > 0;
+    state.mirek_temperature = 0;
+    if (sums.mirek_count > 0) {
+        state.mirek_temperature = qRound(sums.mirek / sums.mirek_count);
     }
+    state.mirek_min = sums.mirek_min;
+    state.mirek_max = sums.mirek_max;
 
     return state;
 }
 
-void delay(int msec)
-{
-    QTime dieTime = QTime::currentTime().addMSecs(msec);
-    while (QTime::currentTime() < dieTime)
-        QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
-}
-
 QColor XYBriToColor(double x, double y, int bri)
 {
     double z = 1.0 - x - y;
@@ -309,42 +397,10 @@ QColor XYBriToColor(double x, double y, int bri)
 
 QVarLengthArray<float> colorToHueXY(QColor color)
 {
-    QVarLengthArray<float> normalizedToOne;
-    float red;
-    float green;
-    float blue;
-
-    normalizedToOne.append(color.red() / 255.0);
-    normalizedToOne.append(color.green() / 255.0);
-    normalizedToOne.append(color.blue() / 255.0);
-
-    // Make red more vivid
-    if (normalizedToOne[0] > 0.04045) {
-        red = qPow((normalizedToOne[0] + 0.055) / (1.0 + 0.055), 2.4);
-    } else {
-        red = (normalizedToOne[0] / 12.92);
-    }
-
-    // Make green more vivid
-    if (normalizedToOne[1] > 0.04045) {
-        green = qPow((normalizedToOne[1] + 0.055) / (1.0 + 0.055), 2.4);
-    } else {
-        green = (normalizedToOne[1] / 12.92);
-    }
-
-    // Make blue more vivid
-    if (normalizedToOne[2] > 0.04045) {
-        blue = qPow((normalizedToOne[2] + 0.055) / (1.0 + 0.055), 2.4);
-    } else {
-        blue = (normalizedToOne[2] / 12.92);
-    }
-
-    float X = (red * 0.649926 + green * 0.103455 + blue * 0.197109);
-    float Y = (red * 0.234327 + green * 0.743075 + blue * 0.022598);
-    float Z = (red * 0.0000000 + green * 0.053077 + blue * 1.035763);
+    double x;
+    double y;
 
-    float x = X / (X + Y + Z);
-    float y = Y / (X + Y + Z);
+    hueRgbToXY(color.redF(), color.greenF(), color.blueF(), x, y);
 
     QVarLengthArray<float> ret;
 
@@ -20,12 +20,25 @@
 
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QJsonDocument>
 #include <QColor>
-#include <QCoreApplication>
-#include <QEventLoop>
+#include <QDeadlineTimer>
 
 #include <menubutton.h>
 
+/* what one scene action sets on its light, without the json around it */
+struct SceneAction {
+    QString light_rid = "";
+    bool on = true;
+    bool has_xy = false;
+    float x = 0.0;
+    float y = 0.0;
+    bool has_mirek = false;
+    int mirek = 0;
+    bool has_dimming = false;
+    float brightness = 100.0;
+};
+
 struct ItemState {
     bool dummy = false; // true -> this state is not useful
 
@@ -51,7 +64,8 @@ struct ItemState {
 
     bool has_gradient = false;
     int gradient_points_capable = 0;
-    QVarLengthArray<QColor> gradient_points;
+    QVarLengthArray<float, 20> gradient_xy; // interleaved x, y per point, as sent to the bridge
+    QVarLengthArray<QColor> gradient_points; // display colors of gradient_xy
 
     QMap<QString, QString> services; // <rid, rtype>
     QMap<QString, QString> children; // <rid, rtype>
@@ -62,9 +76,28 @@ struct ItemState {
     QString group_id = ""; // scene affiliation
     QString group_type = "";
 
+    QVarLengthArray<SceneAction, 8> scene_actions;
+    size_t scene_version = 0; // hash of the actions, changes whenever the scene is edited
+    QVarLengthArray<QColor> scene_palette; // preview colors derived from scene_actions
+
     QVarLengthArray<MenuButton*> items;
 };
 
+enum PendingFields {
+    pending_on = 1,
+    pending_dimming = 2,
+    pending_color = 4,
+    pending_mirek = 8,
+    pending_gradient = 16
+};
+
+/* a command already shown in the ui and not yet confirmed by an event */
+struct PendingMutation {
+    int fields = 0; // PendingFields still waiting for the bridge
+    ItemState confirmed; // the light as last reported by the bridge
+    QDeadlineTimer deadline;
+};
+
 ItemState getDeviceFromJson(QJsonObject json);
 ItemState getLightFromJson(QJsonObject json);
 ItemState getGroupFromJson(QJsonObject json);
@@ -72,10 +105,42 @@ ItemState getSceneFromJson(QJsonObject json);
 
 ItemState updateState(ItemState state, QJsonObject json);
 bool colorIsBlack(QColor color);
-QColor combineTwoColors(QColor base, QColor joiner);
-ItemState combineTwoStates(ItemState base, ItemState joiner);
 
-void delay(int msec);
+struct ScenePalette {
+    size_t version = 0; // scene_version the colors were computed for
+    QVarLengthArray<QColor> colors;
+};
+
+const int scene_palette_size = 5;
+QVarLengthArray<QColor> scenePalette(const QVarLengthArray<SceneAction, 8> &actions, int max_colors = scene_palette_size);
+
+/* running sums over the member lights of a group, independent of their order */
+struct StateSums {
+    int members = 0;
+    int has_on = 0;
+    int on = 0;
+    int has_dimming = 0;
+    int has_color = 0;
+    int has_mirek = 0;
+
+    int brightness_count = 0;
+    double brightness = 0.0;
+
+    int color_count = 0;
+    double red = 0.0;
+    double green = 0.0;
+    double blue = 0.0;
+
+    int mirek_count = 0;
+    double mirek = 0.0;
+    int mirek_min = 0;
+    int mirek_max = 0;
+};
+
+StateSums stateContribution(const ItemState &light);
+void addStateSums(StateSums &sums, const StateSums &light, int sign);
+ItemState combinedState(ItemState base, const StateSums &sums);
+
 
 /*
  Convert xy and brightness to RGB
@@ -0,0 +1,116 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QVBoxLayout>
+
+#include "mainmenuhome.h"
+
+HomeWidget::HomeWidget(HueHome *showed_home, QWidget *parent): QWidget(parent)
+{
+    home = showed_home;
+    connect(home, SIGNAL(homeUpdated()), this, SLOT(setAreas()));
+    connect(home, SIGNAL(resourceChanged(QString)), this, SLOT(updateArea(QString)));
+
+    QVBoxLayout* main_layout = new QVBoxLayout(this);
+
+    main_layout->setAlignment(Qt::AlignTop);
+
+    areas = new MenuExpendable(300, this);
+    connect(areas, SIGNAL(menuToggled()), this, SLOT(autoResize()));
+    main_layout->addWidget(areas);
+
+    setAreas();
+
+    home->refresh();
+}
+
+void HomeWidget::autoResize()
+{
+    emit sizeChanged();
+}
+
+void HomeWidget::setAreas()
+{
+    areas->clearContentButtons();
+    area_buttons.clear();
+
+    all_btn = new MenuButton("", false, -1, false, true, areas);
+    all_btn->setText(tr("Home"));
+    all_btn->setIcon(":images/HueIcons/tabbarHome.svg");
+    connect(all_btn, SIGNAL(switched(QString, bool)), this, SLOT(switchAll(QString, bool)));
+    areas->setHeadMenuButton(*all_btn);
+
+    for (const QString &name : home->areas()) {
+        MenuButton *button = new MenuButton(name, true, -1, false, true, areas);
+        button->setText(name);
+        button->setIcon(":images/HueIcons/roomsOther.svg");
+
+        connect(button, SIGNAL(switched(QString, bool)), this, SLOT(switchArea(QString, bool)));
+        connect(button, SIGNAL(dimmed(QString, int)), this, SLOT(dimmArea(QString, int)));
+
+        areas->addContentMenuButton(*button);
+        area_buttons[name] = button;
+    }
+
+    updateButtons();
+}
+
+void HomeWidget::updateButtons()
+{
+    bool any_on = false;
+
+    QMapIterator<QString, MenuButton*> button(area_buttons);
+    while (button.hasNext()) {
+        button.next();
+
+        bool on = home->areaOn(button.key());
+        any_on |= on;
+
+        button.value()->setSwitch(on);
+        button.value()->setSlider(on ? qRound(home->areaBrightness(button.key())) : 0);
+    }
+
+    all_btn->setSwitch(any_on);
+}
+
+void HomeWidget::updateArea(QString id)
+{
+    HueHomeResource resource = home->resource(id);
+
+    if (resource.type != "room" && resource.type != "zone") {
+        return;
+    }
+
+    updateButtons();
+}
+
+void HomeWidget::switchAll(QString id, bool on)
+{
+    (void) id;
+
+    home->switchAll(on);
+}
+
+void HomeWidget::switchArea(QString id, bool on)
+{
+    home->switchArea(id, on);
+}
+
+void HomeWidget::dimmArea(QString id, int value)
+{
+    home->dimmArea(id, value);
+}
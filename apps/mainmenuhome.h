@@ -0,0 +1,57 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAINMENUHOME_H
+#define MAINMENUHOME_H
+
+#include <QWidget>
+#include <QMap>
+
+#include <huehome.h>
+#include <menuexpendable.h>
+#include <menubutton.h>
+
+class HomeWidget : public QWidget
+{
+    Q_OBJECT
+
+    public:
+        explicit HomeWidget(HueHome *showed_home, QWidget* parent = nullptr);
+
+    protected:
+
+    private:
+        HueHome *home;
+        MenuExpendable* areas;
+        MenuButton* all_btn;
+        QMap<QString, MenuButton*> area_buttons;
+
+        void updateButtons();
+
+    private slots:
+        void setAreas();
+        void updateArea(QString id);
+        void autoResize();
+        void switchAll(QString id, bool on);
+        void switchArea(QString id, bool on);
+        void dimmArea(QString id, int value);
+
+    signals:
+        void sizeChanged();
+};
+
+#endif // MAINMENUHOME_H
@@ -15,13 +15,15 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <huetracer.h>
+
 #include "mainmenusyncbox.h"
 
 SyncboxWidget::SyncboxWidget(HueSyncbox *showed_syncbox, QWidget *parent): QWidget(parent)
 {
     syncbox = showed_syncbox;
     connect(syncbox, SIGNAL(status(QJsonObject)), this, SLOT(updateSyncbox(QJsonObject)));
-    connect(syncbox, SIGNAL(executionFinished()), this, SLOT(checkSyncbox()));
+    connect(syncbox, SIGNAL(executionFinished()), this, SLOT(executionFinished()));
 
     QVBoxLayout* main_layout = new QVBoxLayout(this);
 
@@ -47,6 +49,7 @@ SyncboxWidget::SyncboxWidget(HueSyncbox *showed_syncbox, QWidget *parent): QWidg
     connect(brightness_btn, SIGNAL(dimmed(QString, int)), this, SLOT(changeBrightness(QString, int)));
     brightness_btn->setText(tr("Brightness"));
     brightness_btn->setSliderMax(200);
+    brightness_btn->setSliderTracking(true);
     brightness_btn->setIcon(":images/HueIcons/routinesDaytime.svg");
     main_layout->addWidget(brightness_btn);
 
@@ -61,22 +64,24 @@ SyncboxWidget::SyncboxWidget(HueSyncbox *showed_syncbox, QWidget *parent): QWidg
     main_layout->addWidget(groups);
 
     syncbox->getStatus();
+    syncbox->setPollInterval(poll_interval);
 }
 
-void SyncboxWidget::autoResize()
+SyncboxWidget::~SyncboxWidget()
 {
-    emit sizeChanged();
+    syncbox->setPollInterval(0);
 }
 
-void SyncboxWidget::checkSyncbox()
+void SyncboxWidget::autoResize()
 {
-    syncbox->getStatus();
+    emit sizeChanged();
 }
 
 void SyncboxWidget::changePower(QString id, bool on)
 {
     (void) id;
 
+    HueTraceScope trace(beginTrace("power"));
     syncbox->setPower(on);
 }
 
@@ -84,40 +89,57 @@ void SyncboxWidget::changeBrightness(QString id, int value)
 {
     (void) id;
 
-    syncbox->setBrightness(value);
+    HueTraceScope trace(beginTrace("brightness"));
+    syncbox->streamBrightness(value);
 }
 
 void SyncboxWidget::changeSync(QString id, bool on)
 {
     (void) id;
 
+    HueTraceScope trace(beginTrace("sync"));
     syncbox->setSync(on);
 }
 
 void SyncboxWidget::changeMode()
 {
     MenuButton *btn = qobject_cast<MenuButton *>(sender());
+    HueTraceScope trace(beginTrace("mode"));
     syncbox->setMode(btn->property("mode").toString());
 }
 
 void SyncboxWidget::changeIntensity()
 {
     MenuButton *btn = qobject_cast<MenuButton *>(sender());
+    HueTraceScope trace(beginTrace("intensity"));
     syncbox->setIntensity(btn->property("intensity").toString());
 }
 
 void SyncboxWidget::changeInput()
 {
     MenuButton *btn = qobject_cast<MenuButton *>(sender());
+    HueTraceScope trace(beginTrace("input"));
     syncbox->setInput(btn->property("input").toString());
 }
 
 void SyncboxWidget::changeGroup()
 {
     MenuButton *btn = qobject_cast<MenuButton *>(sender());
+    HueTraceScope trace(beginTrace("group"));
     syncbox->setGroup(btn->property("group").toString());
 }
 
+quint64 SyncboxWidget::beginTrace(QString name)
+{
+    return HueTracer::instance()->begin(name, QStringList(syncbox->id()));
+}
+
+void SyncboxWidget::executionFinished()
+{
+    // the acknowledged values are already merged into the shown state
+    HueTracer::instance()->resourceUpdated(syncbox->id());
+}
+
 void SyncboxWidget::createModes()
 {
     MenuButton* mode_button;
@@ -360,6 +382,10 @@ void SyncboxWidget::updateSyncbox(QJsonObject json)
 {
     updateState(json);
 
+    /* partial updates only refresh the buttons created from the full status */
+    if (rebuild && !json.contains("hue")) {
+        return;
+    }
 
     if (rebuild) {
         createModes();
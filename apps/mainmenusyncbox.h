@@ -32,6 +32,7 @@ class SyncboxWidget : public QWidget
 
     public:
         explicit SyncboxWidget(HueSyncbox *showed_syncbox, QWidget* parent = nullptr);
+        ~SyncboxWidget();
 
     protected:
 
@@ -39,6 +40,7 @@ class SyncboxWidget : public QWidget
         HueSyncbox *syncbox;
         SyncboxState state;
         bool rebuild = true;
+        const int poll_interval = 5000;
 
         MenuButton* main_btn;
         MenuButton* mode_btn;
@@ -64,8 +66,9 @@ class SyncboxWidget : public QWidget
         void setHdmies();
         void setGroups();
 
+        quint64 beginTrace(QString name);
+
     private slots:
-        void checkSyncbox();
         void updateState(QJsonObject json);
         void updateSyncbox(QJsonObject json);
         void autoResize();
@@ -76,6 +79,7 @@ class SyncboxWidget : public QWidget
         void changeIntensity();
         void changeInput();
         void changeGroup();
+        void executionFinished();
 
     signals:
         void sizeChanged();
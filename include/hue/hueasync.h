@@ -0,0 +1,223 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUEASYNC_H
+#define HUEASYNC_H
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+
+#include <QObject>
+#include <QHash>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "huebridge.h"
+#include "huesyncbox.h"
+
+/*
+ Coroutine facade over the request/response signals of the devices.
+ Everything runs on the Qt event loop of the calling thread, a
+ coroutine is resumed from the signal that completes what it waits
+ for. Requests start when they are created, so several of them can be
+ created first and awaited one by one while all are in flight:
+
+     HueAsyncBridge bridge(hue_bridge);
+     HueRequest light = bridge.getLight(id);
+     HueRequest scenes = bridge.getResource("scene");
+     HueReply reply = co_await light;
+*/
+
+struct HueReply {
+    bool ok = false;
+    QString data;
+
+    QJsonObject object() const;
+    QJsonArray array() const;
+};
+
+/* shared between a running coroutine and the task handed to its caller */
+template<typename T>
+struct HueTaskState {
+    bool done = false;
+    std::optional<T> value;
+    std::coroutine_handle<> continuation;
+};
+
+template<>
+struct HueTaskState<void> {
+    bool done = false;
+    std::coroutine_handle<> continuation;
+};
+
+template<typename T>
+struct HueTaskFinal {
+    std::shared_ptr<HueTaskState<T>> state;
+
+    bool await_ready() noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+        std::coroutine_handle<> continuation = state->continuation;
+        state->done = true;
+
+        // the awaiter lives in the frame, nothing of it is touched after this
+        handle.destroy();
+
+        if (continuation) {
+            continuation.resume();
+        }
+    }
+    void await_resume() noexcept {}
+};
+
+template<typename T> class HueTask;
+
+template<typename T>
+struct HueTaskPromiseBase {
+    std::shared_ptr<HueTaskState<T>> state = std::make_shared<HueTaskState<T>>();
+
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    HueTaskFinal<T> final_suspend() noexcept { return {state}; }
+    void unhandled_exception() { std::terminate(); }
+};
+
+template<typename T>
+struct HueTaskPromise : HueTaskPromiseBase<T> {
+    HueTask<T> get_return_object();
+    void return_value(T value) { this->state->value = std::move(value); }
+};
+
+template<>
+struct HueTaskPromise<void> : HueTaskPromiseBase<void> {
+    HueTask<void> get_return_object();
+    void return_void() {}
+};
+
+/*
+ Result of a coroutine. It starts running at once and frees itself when
+ it ends, the task may be dropped when the result is not needed. At
+ most one coroutine may await it.
+*/
+template<typename T = void>
+class HueTask
+{
+    public:
+        using promise_type = HueTaskPromise<T>;
+
+        explicit HueTask(std::shared_ptr<HueTaskState<T>> task_state): state(task_state) {}
+
+        bool done() const { return state->done; }
+
+        bool await_ready() const noexcept { return state->done; }
+        void await_suspend(std::coroutine_handle<> handle) { state->continuation = handle; }
+        T await_resume() {
+            if constexpr (!std::is_void_v<T>) {
+                return std::move(*state->value);
+            }
+        }
+
+    private:
+        std::shared_ptr<HueTaskState<T>> state;
+};
+
+template<typename T>
+HueTask<T> HueTaskPromise<T>::get_return_object()
+{
+    return HueTask<T>(this->state);
+}
+
+inline HueTask<void> HueTaskPromise<void>::get_return_object()
+{
+    return HueTask<void>(state);
+}
+
+/* waits for the reply of one request, identified by its serial */
+class HueRequest
+{
+    public:
+        HueRequest(HueDevice *device, quint64 serial);
+
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> handle);
+        HueReply await_resume();
+
+    private:
+        struct State {
+            bool done = false;
+            HueReply reply;
+            std::coroutine_handle<> continuation;
+            QMetaObject::Connection completed;
+            QMetaObject::Connection destroyed;
+        };
+
+        std::shared_ptr<State> state;
+
+        static void complete(std::shared_ptr<State> state, HueReply reply);
+};
+
+/* resumes the coroutine from a timer */
+class HueDelay
+{
+    public:
+        explicit HueDelay(int msec);
+
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() {}
+
+    private:
+        int delay;
+};
+
+class HueAsyncBridge
+{
+    public:
+        explicit HueAsyncBridge(HueBridge *hue_bridge);
+
+        HueRequest createUser();
+        HueRequest getStatus();
+        HueRequest getResource(QString type);
+        HueRequest getLight(QString id);
+        HueRequest putLight(QString id, QByteArray data);
+        HueRequest putGroupedLight(QString id, QByteArray data);
+        HueRequest putScene(QString id, QByteArray data);
+
+    private:
+        HueBridge *bridge;
+};
+
+class HueAsyncSyncbox
+{
+    public:
+        explicit HueAsyncSyncbox(HueSyncbox *hue_syncbox);
+
+        HueRequest postRegistration();
+        HueRequest getStatus();
+        HueRequest getExecution();
+        HueRequest setExecution(QJsonObject json);
+
+    private:
+        HueSyncbox *syncbox;
+};
+
+/* multi-step flows, the device may be deleted while they wait */
+HueTask<bool> huePairBridge(HueBridge *bridge, int attempts = 30, int interval = 1000);
+HueTask<bool> hueRegisterSyncbox(HueSyncbox *syncbox, int attempts = 8, int interval = 3000);
+HueTask<QHash<QString, QJsonObject>> hueFetchResources(HueBridge *bridge, QStringList types);
+#endif // HUEASYNC_H
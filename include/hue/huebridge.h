@@ -19,11 +19,19 @@
 #define HUEBRIDGE_H
 
 #include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QUdpSocket>
 #include <QUrl>
+#include <QMultiHash>
 #include <QString>
 #include <QJsonObject>
+#include <QSet>
 
 #include "huedevice.h"
+#include "hueevent.h"
+#include "huemdns.h"
+#include "huestate.h"
+
+class HueCommandQueue;
 
 enum HueBridgeRequestTypes {
     req_discovery_bridges,
@@ -32,7 +40,11 @@ enum HueBridgeRequestTypes {
     req_bridge_status_v1,
     req_bridge_config_v1,
     req_bridge_status_v2,
-    req_bridge_put_v2
+    req_bridge_put_v2,
+    req_discovery_sweep,
+    req_bridge_entertainment_v2,
+    req_bridge_entertainment_put_v2,
+    req_bridge_resource_v2
 };
 
 class HueBridgeDiscovery : public QObject
@@ -42,19 +54,43 @@ class HueBridgeDiscovery : public QObject
         explicit HueBridgeDiscovery(QObject *parent = nullptr);
         void discoverBridges();
         void discoverBridge(QString ip);
+        void setSubnetScan(bool enabled);
 
     private:
         const QString discover_url = "https://discovery.meethue.com/";
+        const QString mdns_service = "_hue._tcp.local";
+        const QHostAddress ssdp_address = QHostAddress("239.255.255.250");
+        const quint16 ssdp_port = 1900;
+        const int probe_timeout = 1500;
+        const int sweep_concurrency = 32;
         QNetworkAccessManager *manager;
+        HueMdnsBrowser *mdns;
+        QUdpSocket *ssdp_socket;
+        bool subnet_scan = false;
+
+        QSet<QString> probed_ips; // ips probed in this round
+        QSet<QString> probing_ips; // probes still waiting for their reply
+        QSet<QString> discovered_ids; // bridgeids reported in this round
+        QHash<QString, QJsonObject> discovered_bridges; // <ip, data> reported in this round
+        QHash<QString, QString> mdns_names; // <ip, mdns name>
+        QStringList sweep_queue;
+        int sweep_running = 0;
 
         void readBridges(QJsonArray &data);
-        void readBridge(QJsonObject &data, QString ip);
+        void readBridge(QJsonObject &data, QString ip, bool require_id = false);
+        void probeBridge(QString ip, HueBridgeRequestTypes type);
+        void reportBridge(QJsonObject data, QString ip);
+        void searchSsdp();
+        void sweepSubnet();
+        void sweepNext();
 
     signals:
         void bridgeDiscovered(QJsonObject data, QString ip);
 
     private slots:
         void requestFinished(QNetworkReply *reply);
+        void mdnsResolved(QString name, QString ip, quint16 port, QJsonObject txt);
+        void readSsdp();
 };
 
 
@@ -65,44 +101,79 @@ class HueBridge : public HueDevice
     Q_OBJECT
     public:
         explicit HueBridge(QString ip = "unknown", HueDevice *parent = nullptr);
+        ~HueBridge();
         void setUserName(QString s);
+        QString userName();
+        QString clientKey();
         bool updateBridgeInfo(QJsonObject data);
         QJsonObject dumpBridge();
-        void createUser();
-        void getStatus1();
-        void getConfig1();
-        void getStatus();
-
-        void putLight(QString id, QJsonObject json);
-        void putGroupedLight(QString id, QJsonObject json);
-        void putScene(QString id, QJsonObject json);
+        quint64 createUser();
+        quint64 getStatus1();
+        quint64 getConfig1();
+        quint64 getStatus();
+        quint64 getResource(QString type);
+        quint64 getLight(QString id);
+        void getResources(QStringList types);
+
+        quint64 putLight(QString id, QJsonObject json);
+        quint64 putLight(QString id, QByteArray data);
+        quint64 putGroupedLight(QString id, QJsonObject json);
+        quint64 putGroupedLight(QString id, QByteArray data);
+        quint64 putScene(QString id, QJsonObject json);
+        quint64 putScene(QString id, QByteArray data);
+        HueCommandQueue *commands();
+        quint64 recallScenes(QStringList scene_ids, QString action = "active");
+        quint64 switchGroups(QStringList grouped_light_ids, bool on);
+        quint64 getEntertainmentConfiguration(QString id = "");
+        quint64 putEntertainmentConfiguration(QString id, QJsonObject json);
+
+        HueEventSubscription *subscribe(QStringList types, QStringList rids = QStringList(), QObject *owner = nullptr);
+        void unsubscribe(HueEventSubscription *subscription);
+        QList<HueEventSubscription*> subscribers(const QString &id, const QString &type);
+
+        std::shared_ptr<const HueSnapshot> snapshot();
 
     private:
         QSslConfiguration ssl_configuration = QSslConfiguration::defaultConfiguration();
-        QString url_api_v1 = "http://%1/api";
-        QString url_api_v1_user = url_api_v1 + "/%2/%3";
-        QString url_api_v2 = "https://%1/clip/v2/resource";
-        QString url_api_v2_event_stream = "https://%1/eventstream/clip/v2";
+        const QString path_api_v1 = "/api"; // plain http
+        const QString path_api_v2 = "/clip/v2/resource";
+        const QString path_api_v2_event_stream = "/eventstream/clip/v2";
         QString user_name = "";
         QString client_key = "";
         bool events_running = false;
-        QNetworkAccessManager *event_manager;
+        HueNetworkWorker *event_worker; // long polls, batches arrive parsed and folded
         int event_retries = 0;
+        HueCommandQueue *command_queue;
+        HueStateStore state_store;
+
+        /* every subscription sits in exactly one index */
+        QMultiHash<QString, HueEventSubscription*> subscribed_rids;
+        QMultiHash<QString, HueEventSubscription*> subscribed_types;
+        QList<HueEventSubscription*> subscribed_all;
 
         void readCreateUser(QString ret);
         void runEventStream();
+        void dispatchEvents(const QJsonArray &json_array);
 
     signals:
-        void events(QJsonArray &json_array);
         void userCreationFailed();
         void userCreationSucceed();
         void infoUpdated();
         void statusV2(QJsonObject json);
+        void resourceV2(QString type, QJsonObject json);
+        void snapshotPublished(quint64 version);
+        void entertainmentConfiguration(QJsonObject json);
+        void entertainmentConfigurationUpdated(QJsonObject json);
+        void commandFailed(QString id); // the PUT of this light, grouped_light or scene was rejected
+        void batchFinished(quint64 batch, bool ok); // every command of a recallScenes() or switchGroups() answered
+        void eventStreamRequest(HueWorkerRequest request);
 
     private slots:
         void bridgeRequestFinished(const QVariant type, const QString ret);
+        void bridgeRequestFailed(const QVariant type);
         void startEventStream();
         void stopEventStream();
-        void eventRequestFinished(QNetworkReply *reply);
+        void eventRequestFinished(HueWorkerReply reply);
+        void subscriptionDestroyed(QObject *subscription);
 };
 #endif // HUEBRIDGE_H
\ No newline at end of file
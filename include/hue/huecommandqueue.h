@@ -0,0 +1,113 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUECOMMANDQUEUE_H
+#define HUECOMMANDQUEUE_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QList>
+#include <QHash>
+
+class HueBridge;
+
+enum HueCommandTypes {
+    command_light,
+    command_grouped_light,
+    command_scene
+};
+
+struct HueQueuedCommand {
+    HueCommandTypes type = command_light;
+    QString id;
+    QByteArray data;
+    QString key; // a newer command with the same key replaces this one
+    quint64 trace = 0;
+    quint64 batch = 0; // the batch waiting for this command, 0 for none
+};
+
+struct HueCommandBatch {
+    int waiting = 0; // commands not yet answered by the bridge
+    bool ok = true;
+};
+
+/*
+ Paces the commands of one bridge on a timer. The bridge is sent at
+ most one command per interval, in the order they were queued. A
+ command queued with the key of a waiting one removes it and goes to
+ the tail, so a dragged slider sends only its newest value and nothing
+ overtakes commands queued in between. Switching a light or group off
+ also drops its waiting commands that would switch it on.
+
+ The bridge throttles grouped_light and scene commands to about one per
+ second, so those also wait for the group interval since the last of
+ them. Commands are still sent in order, lights behind a waiting group
+ command wait with it.
+
+ A batch is queued behind everything already waiting and sent in its
+ own order. Waiting commands sharing a key with a batch command are
+ dropped rather than replaced in place, so the batch is never
+ reordered; a batch losing a command that way is not ok. batchFinished()
+ is emitted once the bridge answered every command of the batch, ok
+ only if none failed or was cancelled, and for an empty batch once the
+ event loop runs again.
+*/
+class HueCommandQueue : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit HueCommandQueue(HueBridge *hue_bridge);
+        void setInterval(int msec);
+        void setGroupInterval(int msec);
+        int size();
+
+        void putLight(QString id, QByteArray data, QString key = "");
+        void putGroupedLight(QString id, QByteArray data, QString key = "");
+        void putScene(QString id, QByteArray data, QString key = "");
+        void enqueue(HueQueuedCommand command);
+        quint64 enqueueBatch(QList<HueQueuedCommand> batch_commands);
+        void cancel(QString key);
+        void clear();
+
+    private:
+        HueBridge *bridge;
+        QList<HueQueuedCommand> commands;
+        QTimer *send_timer;
+        QElapsedTimer last_send;
+        QElapsedTimer last_group_send;
+        int interval = 100;
+        int group_interval = 1000;
+        quint64 last_batch = 0;
+        QHash<quint64, HueCommandBatch> batches;
+        QHash<quint64, quint64> batch_serials; // <request serial, batch>
+
+        bool supersedes(const HueQueuedCommand &command, const HueQueuedCommand &waiting);
+        qint64 waitFor(const HueQueuedCommand &command);
+        void schedule();
+        void dropCommand(const HueQueuedCommand &command);
+        void reportDepth();
+        void settleBatch(quint64 batch, bool ok);
+
+    signals:
+        void batchFinished(quint64 batch, bool ok);
+
+    private slots:
+        void sendNext();
+        void requestCompleted(quint64 serial, bool ok, const QString ret);
+};
+#endif // HUECOMMANDQUEUE_H
@@ -24,16 +24,23 @@
 #include <QtNetwork/QNetworkReply>
 #include <QJsonDocument>
 
+#include "huenetworkworker.h"
+
 #define HUEREQUEST_TYPE (QNetworkRequest::Attribute) (((int) QNetworkRequest::User) + 0)
 #define HUEREQUEST_IP (QNetworkRequest::Attribute) (((int) QNetworkRequest::User) + 1)
+#define HUEREQUEST_TAG (QNetworkRequest::Attribute) (((int) QNetworkRequest::User) + 2)
+#define HUEREQUEST_START (QNetworkRequest::Attribute) (((int) QNetworkRequest::User) + 3)
+#define HUEREQUEST_TRACE (QNetworkRequest::Attribute) (((int) QNetworkRequest::User) + 4)
+#define HUEREQUEST_TRACE_SENT (QNetworkRequest::Attribute) (((int) QNetworkRequest::User) + 5)
+#define HUEREQUEST_SERIAL (QNetworkRequest::Attribute) (((int) QNetworkRequest::User) + 6)
+#define HUEREQUEST_IGNORE_SSL (QNetworkRequest::Attribute) (((int) QNetworkRequest::User) + 7)
 
 class HueDevice : public QObject
 {
     Q_OBJECT
     public:
-        QList<QStringList> request_headers;
-
         explicit HueDevice(QString address = "unknown", QObject *parent = nullptr);
+        ~HueDevice();
 
         void setDeviceName(QString s);
         QString deviceName();
@@ -41,6 +48,9 @@ class HueDevice : public QObject
         void setIp(QString s);
         QString ip();
 
+        void setMdnsName(QString s);
+        QString mdnsName();
+
         void setKnown();
         bool known();
 
@@ -50,29 +60,59 @@ class HueDevice : public QObject
         bool deviceConnected();
 
         void setSslConfiguration(QSslConfiguration ssl_configuration);
-        QStringList createHeader(QString key, QString value);
-        void sendRequestGET(QString url, QNetworkRequest::Attribute type);
-        void sendRequestPUT(QString url, QNetworkRequest::Attribute type, const QByteArray json_data);
-        void sendRequestPOST(QString url, QNetworkRequest::Attribute type, const QByteArray data);
-        void sendRequestDELETE(QString url, QNetworkRequest::Attribute type);
+        void setRequestHeader(QString key, QString value);
+        void clearRequestHeaders();
+
+        QUrl deviceUrl(const QString &path, bool secure = true);
+        QNetworkRequest createRequest(const QUrl &url);
+        quint64 sendRequestGET(const QUrl &url, QNetworkRequest::Attribute type, QVariant tag = QVariant());
+        quint64 sendRequestPUT(const QUrl &url, QNetworkRequest::Attribute type, const QByteArray json_data, QVariant tag = QVariant());
+        quint64 sendRequestPOST(const QUrl &url, QNetworkRequest::Attribute type, const QByteArray data);
+        quint64 sendRequestDELETE(const QUrl &url, QNetworkRequest::Attribute type);
+
+    protected:
+        QVariant requestTag();
+        QJsonDocument requestJson();
+        quint64 requestSerial();
 
     private:
-        QNetworkAccessManager *manager;
+        HueNetworkWorker *worker;
         QString ip_address;
         QString identifier = "";
         QString device_name = "";
+        QString mdns_name = "";
         bool paired = false;
         bool device_connected = false;
         bool use_ssl = false;
         QSslConfiguration ssl_conf = QSslConfiguration::defaultConfiguration();
 
+        /* built once per ip, id, certificate or header change; requests only patch url and type */
+        QUrl base_url_https;
+        QUrl base_url_http;
+        QList<QPair<QByteArray, QByteArray>> raw_headers;
+        QNetworkRequest request_template;
+        QVariant current_tag; // tag of the reply being handled
+        QJsonDocument current_json; // body of the reply being handled, parsed by the worker
+        quint64 current_serial = 0; // serial of the reply being handled
+        bool was_connected = false;
+        quint64 last_serial = 0;
+
+        void rebuildRequestTemplate();
+        void startRequest(QNetworkRequest &request, QNetworkRequest::Attribute type);
+        quint64 sendRequest(QNetworkRequest &request, QNetworkAccessManager::Operation operation, const QByteArray data = QByteArray());
+
     signals:
         void requestDeviceFinished(const QVariant type, const QString ret);
+        void requestDeviceFailed(const QVariant type);
+        void requestCompleted(quint64 serial, bool ok, const QString ret); // every request, after the typed signals
         void connected();
         void disconnected();
+        void idChanged(QString previous);
+        void ipChanged(QString previous);
+        void mdnsNameChanged(QString previous);
+        void workerRequest(HueWorkerRequest request);
 
     private slots:
-        void onSslError(QNetworkReply* r, QList<QSslError> l);
-        void requestFinished(QNetworkReply *reply);
+        void requestFinished(HueWorkerReply reply);
 };
 #endif // HUEDEVICE_H
\ No newline at end of file
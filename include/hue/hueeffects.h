@@ -0,0 +1,110 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUEEFFECTS_H
+#define HUEEFFECTS_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+#include <QRandomGenerator>
+
+#include "huebridge.h"
+#include "hueentertainment.h"
+
+enum HueEffectTypes {
+    effect_none,
+    effect_color_loop,
+    effect_candle,
+    effect_gradient_chase
+};
+
+struct HueEffectStats {
+    quint64 frames = 0;
+    qint64 jitter_max_us = 0;
+    qint64 jitter_mean_us = 0;
+    qint64 cpu_max_us = 0;
+    qint64 cpu_mean_us = 0;
+    quint64 budget_misses = 0;
+    quint64 coalesced = 0; // REST values replaced before they were sent
+};
+
+/*
+ Deterministic generative effects. Frames are computed in batch at a
+ fixed rate for every output. An output is a light when the frames
+ go over CLIP v2, or a channel when an entertainment stream is set
+ and running. The same seed always gives the same frames.
+*/
+class HueEffects : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit HueEffects(HueBridge *hue_bridge, QObject *parent = nullptr);
+        void setLights(QStringList light_ids);
+        void setEntertainment(HueEntertainment *hue_entertainment);
+        void setPalette(QVector<HueStreamChannel> colors);
+        void setBrightness(double value);
+        void setPeriod(int msec);
+        void setBudget(int jitter_us, int cpu_us);
+        void start(HueEffectTypes type, int fps = 25, quint32 seed = 0);
+        void stop();
+        HueEffectTypes effect();
+        HueEffectStats stats();
+        void computeFrame(quint64 frame, QVector<HueStreamChannel> &outputs);
+
+    private:
+        const int rest_interval = 100; // the bridge handles about 10 light commands per second
+        HueBridge *bridge;
+        HueEntertainment *entertainment = nullptr;
+        HueEffectTypes running_effect = effect_none;
+        QStringList lights;
+        QVector<HueStreamChannel> palette;
+        QVector<HueStreamChannel> outputs;
+        QVector<double> flicker;
+        QRandomGenerator random;
+        double brightness = 1.0;
+        int period = 10000;
+        int fps = 25;
+        quint64 frame = 0;
+
+        QTimer *frame_timer;
+        QElapsedTimer frame_clock;
+        qint64 last_tick_ns = 0;
+        qint64 jitter_budget_us = 0;
+        qint64 cpu_budget_us = 0;
+        qint64 jitter_sum_us = 0;
+        qint64 cpu_sum_us = 0;
+        HueEffectStats effect_stats;
+
+        QTimer *rest_timer;
+        QHash<QString, HueStreamChannel> rest_pending;
+        int rest_next = 0;
+
+        bool streamingOutputs();
+        void pushFrame();
+
+    signals:
+        void budgetExceeded(qint64 jitter_us, qint64 cpu_us);
+
+    private slots:
+        void tick();
+        void sendRest();
+};
+
+#endif // HUEEFFECTS_H
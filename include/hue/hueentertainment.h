@@ -0,0 +1,99 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUEENTERTAINMENT_H
+#define HUEENTERTAINMENT_H
+
+#include <QObject>
+#include <QMap>
+#include <QTimer>
+#include <QJsonObject>
+#include <QtNetwork/QUdpSocket>
+#include <QtNetwork/QDtls>
+#include <QtNetwork/QSslPreSharedKeyAuthenticator>
+
+#include "huebridge.h"
+
+struct HueStreamChannel {
+    double x = 0.0;
+    double y = 0.0;
+    double brightness = 0.0; // 0.0 - 1.0
+};
+
+/*
+ Encode one HueStream v2 message (xy colour space).
+ https://developers.meethue.com/develop/hue-entertainment/hue-entertainment-api/
+*/
+QByteArray hueStreamFrame(QString configuration_id, quint8 sequence, const QMap<quint8, HueStreamChannel> &channels);
+
+/*
+ Streams frames to an entertainment configuration over DTLS.
+ start() activates the configuration over CLIP v2 and opens the
+ stream, startStream() only opens the stream, so it can be pointed
+ to a local DTLS server with setEndpoint().
+*/
+class HueEntertainment : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit HueEntertainment(HueBridge *hue_bridge, QObject *parent = nullptr);
+        ~HueEntertainment();
+        void start(QString configuration_id);
+        void startStream(QString configuration_id);
+        void stop();
+        bool streaming();
+        void setRate(int hz);
+        void setEndpoint(QString ip, quint16 port);
+        void setPskIdentity(QString identity);
+        QList<quint8> channels();
+        QStringList lightServices();
+        void setChannel(quint8 channel, HueStreamChannel value);
+
+    private:
+        const quint16 stream_port = 2100;
+        const int max_channels = 20;
+        HueBridge *bridge;
+        QUdpSocket *socket;
+        QDtls *dtls = nullptr;
+        QTimer *frame_timer;
+        QString endpoint_ip = "";
+        quint16 endpoint_port = 0;
+        QString psk_identity = "";
+        QString configuration = "";
+        QList<quint8> configuration_channels;
+        QStringList configuration_lights;
+        QMap<quint8, HueStreamChannel> frame_channels;
+        quint8 sequence = 0;
+        bool starting = false;
+
+        void closeStream();
+
+    signals:
+        void started();
+        void stopped();
+        void failed(QString reason);
+
+    private slots:
+        void readConfiguration(QJsonObject json);
+        void configurationUpdated(QJsonObject json);
+        void readDatagrams();
+        void pskRequired(QSslPreSharedKeyAuthenticator *authenticator);
+        void handshakeTimeout();
+        void sendFrame();
+};
+
+#endif // HUEENTERTAINMENT_H
@@ -0,0 +1,85 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUEEVENT_H
+#define HUEEVENT_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QStringList>
+
+enum HueEventTypes {
+    event_add,
+    event_update,
+    event_delete,
+    event_error
+};
+
+/* one resource delta of the CLIP v2 event stream */
+struct HueEvent {
+    HueEventTypes event = event_update;
+    QString id = "";
+    QString type = ""; // resource type, light, motion, ...
+    QString owner = ""; // rid of the owning device or group
+    QDateTime created;
+
+    /* decoded for lights and grouped lights */
+    bool has_on = false;
+    bool on = false;
+    bool has_brightness = false;
+    double brightness = 0.0;
+    bool has_xy = false;
+    double x = 0.0;
+    double y = 0.0;
+    bool has_mirek = false;
+    int mirek = 0;
+
+    QJsonObject data; // the whole delta as sent by the bridge
+};
+Q_DECLARE_METATYPE(HueEvent)
+
+HueEventTypes hueEventType(const QString &type);
+HueEvent hueDecodeEvent(HueEventTypes event_type, const QDateTime &created, const QJsonObject &json);
+void hueMergeUpdate(QJsonObject &target, const QJsonObject &update);
+QJsonArray hueCompactEvents(const QJsonArray &containers);
+
+/*
+ Receives the events of the given resource types (any type when empty)
+ restricted to the given rids (any rid when empty). batchFinished() follows
+ the last event of one stream message which reached this subscription.
+*/
+class HueEventSubscription : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit HueEventSubscription(QStringList resource_types, QStringList resource_rids, QObject *parent = nullptr);
+        QStringList types();
+        QStringList rids();
+        bool matches(const QString &id, const QString &type);
+
+    private:
+        QStringList filter_types;
+        QStringList filter_rids;
+
+    signals:
+        void received(const HueEvent &event);
+        void batchFinished();
+};
+
+#endif // HUEEVENT_H
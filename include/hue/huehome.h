@@ -0,0 +1,103 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUEHOME_H
+#define HUEHOME_H
+
+#include <QObject>
+#include <QHash>
+#include <QMultiHash>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "huebridgelist.h"
+#include "huebridge.h"
+#include "hueevent.h"
+
+/* a light, room, zone, bridge_home or scene of any bridge */
+struct HueHomeResource {
+    QString id = "";
+    QString type = "";
+    QString name = "";
+    QString archetype = "";
+    QString group = ""; // scenes: the room or zone they belong to
+    QString grouped_light = ""; // rooms, zones and bridge_home
+    QStringList lights; // rooms, zones and bridge_home: rids of member lights
+
+    bool on = false;
+    double brightness = 0.0; // 0.0 - 100.0
+
+    HueBridge *bridge = nullptr;
+};
+
+/*
+ One model over all known bridges of the list. Rids are unique across
+ bridges, so resources share one index and every command goes to the
+ command queue of the bridge which owns the resource. Rooms and zones
+ with the same name on different bridges form one area; area commands
+ are sent to all owning bridges at once.
+*/
+class HueHome : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit HueHome(HueBridgeList *bridge_list, QObject *parent = nullptr);
+        void refresh();
+
+        QList<HueHomeResource> resources(QString type);
+        HueHomeResource resource(QString id);
+        HueBridge *owner(QString id);
+
+        QStringList areas();
+        QList<HueHomeResource> area(QString name);
+        bool areaOn(QString name);
+        double areaBrightness(QString name);
+
+        void switchAll(bool on);
+        void switchArea(QString name, bool on);
+        void dimmArea(QString name, double brightness);
+        void switchLight(QString id, bool on);
+        void dimmLight(QString id, double brightness);
+        void recallScene(QString id);
+
+    private:
+        HueBridgeList *bridges;
+        QHash<HueEventSubscription*, HueBridge*> attached;
+        const QStringList home_types = {"bridge_home", "room", "zone", "device", "light", "grouped_light", "scene"};
+
+        QHash<QString, HueHomeResource> home_resources; // <rid, resource>
+        QMultiHash<QString, QString> area_index; // <name, room or zone rid>
+        QHash<QString, QString> grouped_light_index; // <grouped_light rid, group rid>
+
+        void removeBridgeResources(HueBridge *bridge);
+        void detachBridge(HueBridge *bridge);
+        void readBridge(HueBridge *bridge); // rebuilds the resources of the bridge from its snapshot
+        void rebuildIndexes();
+
+    signals:
+        void homeUpdated();
+        void resourceChanged(QString id);
+
+    private slots:
+        void attachBridges();
+        void readStatus(QJsonObject json);
+        void readResource(QString type, QJsonObject json);
+        void bridgeDestroyed(QObject *bridge);
+        void readEvent(const HueEvent &event);
+};
+
+#endif // HUEHOME_H
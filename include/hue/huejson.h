@@ -0,0 +1,68 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUEJSON_H
+#define HUEJSON_H
+
+#include <QByteArray>
+#include <QString>
+#include <QJsonValue>
+
+/*
+ Compact JSON writer for request bodies. Writes straight into one
+ buffer instead of building a QJsonObject tree and printing it.
+ Keys are plain ASCII literals, string values are escaped.
+
+ HueJsonWriter writer;
+ writer.beginObject().beginObject("on").value("on", true).endObject().endObject();
+ bridge->putLight(id, writer.take());
+*/
+class HueJsonWriter
+{
+    public:
+        explicit HueJsonWriter(int reserve = 128);
+        HueJsonWriter &beginObject(const char *key = nullptr);
+        HueJsonWriter &endObject();
+        HueJsonWriter &beginArray(const char *key = nullptr);
+        HueJsonWriter &endArray();
+        HueJsonWriter &value(const char *key, bool value);
+        HueJsonWriter &value(const char *key, int value);
+        HueJsonWriter &value(const char *key, double value);
+        HueJsonWriter &value(const char *key, const char *value);
+        HueJsonWriter &value(const char *key, const QString &value);
+        HueJsonWriter &value(const char *key, const QJsonValue &value);
+        QByteArray take();
+
+    private:
+        int reserve_size;
+        QByteArray buffer;
+        bool first = true; // nothing written yet in the current object or array
+
+        void writeKey(const char *key);
+        void writeString(const QString &value);
+};
+
+/* CLIP v2 light and grouped_light bodies */
+QByteArray hueOnBody(bool on);
+QByteArray hueDimmingBody(double brightness);
+QByteArray hueColorBody(double x, double y);
+QByteArray hueMirekBody(int mirek);
+
+/* CLIP v2 scene body */
+QByteArray hueRecallBody(const char *action);
+
+#endif // HUEJSON_H
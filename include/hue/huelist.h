@@ -19,6 +19,10 @@
 #define HUELIST_H
 
 #include <QObject>
+#include <QHash>
+#include <QList>
+
+#include "huedevice.h"
 
 class HueList : public QObject
 {
@@ -27,11 +31,26 @@ class HueList : public QObject
         explicit HueList(QObject *parent = 0);
         QString getStoragePath(QString name);
 
+    protected:
+        HueDevice* findDevice(QString s);
+        void indexDevice(HueDevice *device);
+        void unindexDevice(HueDevice *device);
+
     private:
+        /* hash indices, kept up to date by the device change signals */
+        QList<HueDevice*> indexed_devices; // in list order, the first device with a key owns it
+        QHash<QString, HueDevice*> index_id;
+        QHash<QString, HueDevice*> index_ip;
+        QHash<QString, HueDevice*> index_mdns_name;
+
+        void reindex(QHash<QString, HueDevice*> &index, QString (HueDevice::*key)(), HueDevice *device, QString previous, QString current);
 
     signals:
 
     private slots:
+        void deviceIdChanged(QString previous);
+        void deviceIpChanged(QString previous);
+        void deviceMdnsNameChanged(QString previous);
 };
 
 #endif // HUELIST_H
\ No newline at end of file
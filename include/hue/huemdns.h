@@ -0,0 +1,62 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUEMDNS_H
+#define HUEMDNS_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QJsonObject>
+#include <QtNetwork/QUdpSocket>
+
+/*
+ Minimal one-shot mDNS (RFC 6762) browser. The query is sent from
+ an ephemeral port, so responders answer with legacy unicast and we
+ do not need to share port 5353 with the system resolver.
+*/
+class HueMdnsBrowser : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit HueMdnsBrowser(QObject *parent = nullptr);
+        void browse(QString service);
+
+    private:
+        const QHostAddress mdns_address = QHostAddress("224.0.0.251");
+        const quint16 mdns_port = 5353;
+        QUdpSocket *socket;
+        QString browsed_service = "";
+
+        QSet<QString> instances; // instance names of the browsed service
+        QSet<QString> resolved; // instance names already reported
+        QHash<QString, QString> srv_targets; // <instance, target host>
+        QHash<QString, quint16> srv_ports; // <instance, port>
+        QHash<QString, QJsonObject> txt_records; // <instance, txt>
+        QHash<QString, QString> addresses; // <target host, ip>
+
+        QByteArray createQuery(QString service);
+        void readResponse(const QByteArray &data, QString sender);
+
+    signals:
+        void serviceResolved(QString name, QString ip, quint16 port, QJsonObject txt);
+
+    private slots:
+        void readDatagrams();
+};
+
+#endif // HUEMDNS_H
@@ -0,0 +1,92 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUEMETRICS_H
+#define HUEMETRICS_H
+
+#include <QObject>
+#include <QMutex>
+#include <QHash>
+#include <QUrl>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QNetworkAccessManager>
+
+#define HUEMETRICS_BUCKETS 10
+
+struct HueLatencyHistogram {
+    quint64 counts[HUEMETRICS_BUCKETS] = {}; // upper bounds in hueLatencyBounds, the last one is open
+    quint64 total = 0;
+    quint64 errors = 0;
+    qint64 sum_ms = 0;
+    qint64 max_ms = 0;
+};
+
+/*
+ Process wide counters of the device I/O. Every method may be called
+ from any thread. The collected values are available as JSON through
+ dump() or from a local socket opened by listen(), one dump per
+ connection.
+*/
+class HueMetrics : public QObject
+{
+    Q_OBJECT
+    public:
+        static HueMetrics *instance();
+
+        qint64 now();
+        static QString endpoint(QNetworkAccessManager::Operation operation, const QUrl &url);
+
+        void requestStarted();
+        void requestFinished(const QString &endpoint, qint64 elapsed_ms, bool ok);
+        void setQueueDepth(const QString &queue, int depth);
+        void addCoalesced(const QString &queue, int count = 1);
+        void addEventLag(qint64 lag_ms);
+        void addReconnect(const QString &source);
+
+        QJsonObject dump();
+        QByteArray dumpJson();
+        bool listen(const QString &name);
+
+    public slots:
+        void stopListening();
+
+    private:
+        explicit HueMetrics(QObject *parent = nullptr);
+
+        QMutex mutex;
+        QElapsedTimer clock;
+        QLocalServer *server = nullptr;
+        const int probe_timeout = 200;
+
+        int in_flight = 0;
+        int in_flight_max = 0;
+        QHash<QString, HueLatencyHistogram> latencies; // <endpoint, histogram>
+        QHash<QString, int> queue_depths;
+        QHash<QString, int> queue_depths_max;
+        QHash<QString, quint64> coalesced;
+        QHash<QString, quint64> reconnects;
+        HueLatencyHistogram event_lag;
+
+        void addSample(HueLatencyHistogram &histogram, qint64 value_ms, bool ok);
+        QJsonObject histogramJson(const HueLatencyHistogram &histogram);
+
+    private slots:
+        void clientConnected();
+};
+#endif // HUEMETRICS_H
@@ -0,0 +1,74 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUENETWORKWORKER_H
+#define HUENETWORKWORKER_H
+
+#include <QObject>
+#include <QThread>
+#include <QJsonDocument>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkRequest>
+#include <QtNetwork/QNetworkReply>
+
+struct HueWorkerRequest {
+    QNetworkRequest request;
+    QNetworkAccessManager::Operation operation = QNetworkAccessManager::GetOperation;
+    QByteArray data;
+};
+
+struct HueWorkerReply {
+    QNetworkRequest request;
+    QNetworkAccessManager::Operation operation = QNetworkAccessManager::GetOperation;
+    bool ok = false;
+    QString error;
+    QString body;
+    QJsonDocument json; // parsed in the worker, null when the body is not JSON
+};
+
+Q_DECLARE_METATYPE(HueWorkerRequest)
+Q_DECLARE_METATYPE(HueWorkerReply)
+
+/*
+ Runs the requests of one device in the network thread shared by all
+ devices. The reply body is read and parsed there, the device gets the
+ finished reply by a queued signal. A worker created for an event
+ stream also folds the light updates of one batch into one change per
+ light.
+*/
+class HueNetworkWorker : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit HueNetworkWorker(bool compact_events = false);
+        static QThread *networkThread();
+
+    public slots:
+        void send(HueWorkerRequest request);
+
+    signals:
+        void finished(HueWorkerReply reply);
+
+    private:
+        QNetworkAccessManager *manager = nullptr;
+        bool compact = false;
+
+    private slots:
+        void replyFinished(QNetworkReply *reply);
+        void sslErrors(QNetworkReply *reply, QList<QSslError> errors);
+};
+#endif // HUENETWORKWORKER_H
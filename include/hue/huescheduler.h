@@ -0,0 +1,189 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUESCHEDULER_H
+#define HUESCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QDateTime>
+#include <QStringList>
+
+class HueBridge;
+
+enum HueScheduleTriggers {
+    schedule_cron,
+    schedule_sunrise,
+    schedule_sunset
+};
+
+enum HueScheduleActions {
+    schedule_recall_scene,
+    schedule_switch_on,
+    schedule_switch_off
+};
+
+/* the five fields of a cron expression as bit sets */
+struct HueCron {
+    bool valid = false;
+    quint64 minutes = 0; // bits 0 - 59
+    quint32 hours = 0; // bits 0 - 23
+    quint32 days = 0; // bits 1 - 31
+    quint16 months = 0; // bits 1 - 12
+    quint8 weekdays = 0; // bits 0 - 6, sunday is 0
+    bool any_day = true;
+    bool any_weekday = true;
+};
+
+// Parse "minute hour day month weekday". Every field takes *, numbers,
+// ranges a-b, lists a,b and steps */n or a-b/n; weekday 7 is sunday.
+HueCron hueParseCron(const QString &expression);
+
+/* the first local time matching the cron after the given time, invalid if none within four years */
+QDateTime hueCronNext(const HueCron &cron, const QDateTime &after);
+
+/* sunrise or sunset of the date in UTC, invalid during polar day or night */
+QDateTime hueSunEvent(QDate date, double latitude, double longitude, bool sunrise);
+
+struct HueScheduleRule {
+    QString id = "";
+    bool enabled = true;
+
+    HueScheduleTriggers trigger = schedule_cron;
+    QString cron = ""; // schedule_cron
+    int offset = 0; // seconds after sunrise or sunset, negative for before
+
+    HueScheduleActions action = schedule_recall_scene;
+    QString target = ""; // scene rid, or grouped_light rid to switch
+
+    bool catch_up = true; // run once if its time passed while the scheduler was not running
+    int catch_up_limit = 3600; // seconds, older missed runs are skipped
+    QDateTime last_run; // restored from storage, missed runs since then are caught up
+};
+
+/* the time the scheduler runs on, replaced by a fake clock in tests */
+class HueClock
+{
+    public:
+        virtual ~HueClock() {}
+        virtual QDateTime now() const;
+};
+
+/* where due rules are sent, HueBridgeCommandSink or a mock recording the calls */
+class HueCommandSink
+{
+    public:
+        virtual ~HueCommandSink() {}
+        virtual void recallScenes(QStringList scene_ids) = 0;
+        virtual void switchGroups(QStringList grouped_light_ids, bool on) = 0;
+};
+
+/* sends through the command queue of the bridge as one batch per tick */
+class HueBridgeCommandSink : public HueCommandSink
+{
+    public:
+        explicit HueBridgeCommandSink(HueBridge *hue_bridge);
+        void recallScenes(QStringList scene_ids) override;
+        void switchGroups(QStringList grouped_light_ids, bool on) override;
+
+    private:
+        HueBridge *bridge;
+};
+
+/*
+ Runs cron and sunrise/sunset rules locally. Pending runs sit in a
+ hashed timer wheel of one second ticks; a tick only looks at its own
+ slot, so thousands of rules cost a few entries per second. Runs due
+ far ahead wrap around the wheel and stay in their slot until their
+ tick comes.
+
+ Every tick advances the wheel to the clock. After a suspend or a stall
+ the skipped ticks are walked (or the whole wheel when more than one
+ turn was missed). Of the runs a rule missed only the latest one counts;
+ it is caught up once or skipped, see HueScheduleRule::catch_up. A clock going backwards
+ reschedules all rules.
+
+ Rules due in the same tick are applied in the order of their times,
+ consecutive rules with the same action go to the sink as one batch.
+ With a fake clock and a mock sink, advance() drives the scheduler
+ without a bridge or an event loop timer.
+*/
+class HueScheduler : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit HueScheduler(HueCommandSink *command_sink, HueClock *scheduler_clock = nullptr, QObject *parent = nullptr);
+        ~HueScheduler();
+        void setLocation(double latitude, double longitude);
+        void start();
+        void stop();
+
+        bool addRule(HueScheduleRule rule);
+        void removeRule(QString id);
+        QList<HueScheduleRule> rules();
+        QDateTime nextRun(QString id);
+
+    public slots:
+        void advance();
+
+    private:
+        struct WheelEntry {
+            QString id;
+            qint64 due_tick;
+            quint64 generation; // stale entries of changed or removed rules are dropped lazily
+        };
+
+        struct RuleState {
+            HueScheduleRule rule;
+            HueCron cron;
+            QDateTime next_run;
+            quint64 generation = 0; // of the wheel entry holding next_run
+        };
+
+        const int tick_msec = 1000;
+        const int wheel_slots = 512;
+        const int late_grace = 2; // ticks, later runs count as missed
+
+        HueCommandSink *sink;
+        HueClock *clock;
+        bool own_clock = false;
+        QTimer *tick_timer;
+
+        bool has_location = false;
+        double location_latitude = 0.0;
+        double location_longitude = 0.0;
+
+        QVector<QList<WheelEntry>> wheel;
+        QHash<QString, RuleState> rule_states;
+        qint64 current_tick = 0;
+        quint64 last_generation = 0;
+
+        QDateTime computeNextRun(const RuleState &state, const QDateTime &after);
+        QDateTime latestMissedRun(const RuleState &state, const QDateTime &oldest, const QDateTime &now);
+        void schedule(RuleState &state, const QDateTime &after);
+        void rescheduleAll();
+        void collectSlot(int slot, qint64 now_tick, QList<WheelEntry> &due);
+
+    signals:
+        void ruleFired(QString id, QDateTime scheduled);
+        void ruleSkipped(QString id, QDateTime scheduled);
+};
+
+#endif // HUESCHEDULER_H
@@ -0,0 +1,126 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUESENSOR_H
+#define HUESENSOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "huebridge.h"
+
+enum HueSensorTypes {
+    sensor_unknown,
+    sensor_motion,
+    sensor_temperature,
+    sensor_light_level,
+    sensor_button,
+    sensor_device_power
+};
+
+struct HueSensorState {
+    QString id = "";
+    QString owner = ""; // rid of the device
+    HueSensorTypes type = sensor_unknown;
+    bool enabled = true;
+
+    bool motion = false;
+    double temperature = 0.0; // celsius
+    int light_level = 0; // 10000 * log10(lux) + 1
+    QString button_event = ""; // initial_press, repeat, short_release, long_release, ...
+    int battery_level = -1;
+    QString battery_state = "";
+
+    QDateTime changed;
+};
+Q_DECLARE_METATYPE(HueSensorState)
+
+HueSensorTypes hueSensorType(const QString &type);
+QString hueSensorTypeName(HueSensorTypes type);
+QStringList hueSensorTypeNames(QList<HueSensorTypes> types = QList<HueSensorTypes>());
+double hueLightLevelToLux(int light_level);
+
+/*
+ Apply a CLIP v2 resource or event delta to the sensor.
+ Returns true when a reported value changed.
+*/
+bool hueSensorUpdate(HueSensorState &state, const QJsonObject &json);
+
+/*
+ Receives the sensors matching its filter: all of the given types (any
+ type when empty) restricted to the given rids (any rid when empty).
+ The filter is registered with the bridge as an event subscription, so
+ the sensors are matched by the bridge's own index.
+*/
+class HueSensorSubscription : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit HueSensorSubscription(QList<HueSensorTypes> sensor_types, QStringList sensor_rids, HueBridge *bridge, QObject *parent = nullptr);
+        QList<HueSensorTypes> types();
+        QStringList rids();
+        bool matches(const HueSensorState &state);
+
+    private:
+        QList<HueSensorTypes> filter_types;
+        QStringList filter_rids;
+        HueEventSubscription *events;
+
+    signals:
+        void sensorChanged(HueSensorState state);
+        void sensorRemoved(QString id);
+};
+
+/*
+ Typed sensor resources of one bridge. Only motion, temperature,
+ light_level, button and device_power resources are fetched and
+ decoded, the bridge only passes events of those types.
+*/
+class HueSensors : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit HueSensors(HueBridge *hue_bridge, QObject *parent = nullptr);
+        void load();
+        HueSensorSubscription *subscribe(QList<HueSensorTypes> types, QStringList rids = QStringList());
+        void unsubscribe(HueSensorSubscription *subscription);
+        QList<HueSensorState> sensors(HueSensorTypes type = sensor_unknown);
+        HueSensorState sensor(QString id);
+
+    private:
+        HueBridge *bridge;
+        HueEventSubscription *events;
+        QHash<QString, HueSensorState> sensor_states;
+        QSet<QString> loading_types;
+
+        void updateSensor(const QJsonObject &json, HueSensorTypes type, bool notify);
+        void removeSensor(const QString &id);
+        QList<HueSensorSubscription*> subscribers(const QString &id, HueSensorTypes type);
+
+    signals:
+        void sensorsLoaded();
+
+    private slots:
+        void readResource(QString type, QJsonObject json);
+        void readEvent(const HueEvent &event);
+};
+
+#endif // HUESENSOR_H
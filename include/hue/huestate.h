@@ -0,0 +1,68 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUESTATE_H
+#define HUESTATE_H
+
+#include <atomic>
+#include <memory>
+
+#include <QHash>
+#include <QStringList>
+#include <QJsonObject>
+#include <QJsonArray>
+
+/* one immutable view of all resources of a bridge */
+struct HueSnapshot {
+    quint64 version = 0;
+    QHash<QString, QHash<QString, QJsonObject>> resources; // <type, <rid, resource as sent by the bridge>>
+    QHash<QString, QString> types; // <rid, type>
+
+    QJsonObject resource(const QString &id) const;
+    QList<QJsonObject> resourcesOfType(const QString &type) const;
+};
+
+/*
+ Keeps the resources of a bridge as versioned snapshots. The writer
+ copies the current snapshot, changes the copy and publishes it with
+ one atomic store. Resources are kept in one hash per type and the
+ hashes are implicitly shared, so changing a resource detaches the
+ small outer hash and the hash of its type only; an event batch with
+ light updates copies the lights, not the whole bridge. Readers on any
+ thread take the current snapshot and keep a consistent view as long
+ as they hold it. Only one thread may write.
+*/
+class HueStateStore
+{
+    public:
+        HueStateStore();
+
+        std::shared_ptr<const HueSnapshot> snapshot() const;
+
+        quint64 replaceAll(const QJsonArray &data);
+        quint64 replaceType(const QString &type, const QJsonArray &data);
+        quint64 upsert(const QJsonArray &data);
+        quint64 applyEvents(const QJsonArray &containers);
+
+    private:
+        std::atomic<std::shared_ptr<const HueSnapshot>> current;
+
+        static void insertResource(HueSnapshot &next, const QJsonObject &resource);
+        static void removeResource(HueSnapshot &next, const QString &id);
+        quint64 publish(HueSnapshot &next);
+};
+#endif // HUESTATE_H
@@ -20,14 +20,59 @@
 
 #include <QJsonObject>
 #include <QTimer>
+#include <QHash>
+#include <QSet>
 
 #include "huedevice.h"
+#include "huemdns.h"
+
+template<typename T> class HueTask;
 
 enum HueSyncboxRequestTypes {
     req_registration,
     req_device,
     req_syncbox_status,
-    req_syncbox_put_execution
+    req_syncbox_put_execution,
+    req_discovery_syncbox,
+    req_syncbox_execution,
+    req_syncbox_hdmi,
+    req_syncbox_put_brightness
+};
+
+class HueSyncboxDiscovery : public QObject
+{
+    Q_OBJECT
+    public:
+        explicit HueSyncboxDiscovery(QObject *parent = nullptr);
+        void discoverSyncboxes();
+        void discoverSyncbox(QString ip);
+
+    private:
+        const QString mdns_service = "_huesync._tcp.local";
+        const int probe_timeout = 1500;
+        QNetworkAccessManager *manager;
+        HueMdnsBrowser *mdns;
+
+        QSet<QString> probed_ips; // ips probed in this round
+        QSet<QString> discovered_ids; // uniqueIds reported in this round
+        QHash<QString, QString> mdns_names; // <ip, mdns name>
+
+        void readSyncbox(QJsonObject &data, QString ip);
+
+    signals:
+        void syncboxDiscovered(QJsonObject data, QString ip);
+
+    private slots:
+        void onSslError(QNetworkReply* r, QList<QSslError> l);
+        void requestFinished(QNetworkReply *reply);
+        void mdnsResolved(QString name, QString ip, quint16 port, QJsonObject txt);
+};
+
+/* an execution PUT waiting for its reply, a single value or a whole body */
+struct HueSyncboxExecution {
+    const char *key = nullptr;
+    QJsonValue value;
+    QJsonObject json; // setExecution() only
 };
 
 class HueSyncbox : public HueDevice
@@ -39,26 +84,47 @@ class HueSyncbox : public HueDevice
         bool updateSyncboxInfo(QJsonObject data);
         QJsonObject dumpSyncbox();
         void createRegistration();
-        void getDevice();
-        void getStatus();
-        void setExecution(QJsonObject json);
+        quint64 postRegistration();
+        quint64 getDevice();
+        quint64 getStatus();
+        quint64 getExecution();
+        quint64 getHdmi();
+        void setPollInterval(int msec);
+        quint64 setExecution(QJsonObject json);
         void setPower(bool on);
         void setSync(bool on);
         void setMode(QString mode);
         void setIntensity(QString intensity);
         void setBrightness(int brightness);
+        void streamBrightness(int brightness);
         void setInput(QString input);
         void setGroup(QString groupid);
 
     private:
         QSslConfiguration ssl_configuration = QSslConfiguration::defaultConfiguration();
-        QString url_api_v1 = "https://%1/api/v1/%2";
-        int registration_counter;
-        QTimer *registration_timer;
+        const QString path_api_v1 = "/api/v1/";
+        bool registering = false;
         QString access_token = "";
         QString registration_id;
 
+        QJsonObject status_cache; // the whole /api/v1 tree, updated section by section
+        QHash<quint64, HueSyncboxExecution> pending_executions; // <request serial, body> sent and not yet acknowledged
+        QTimer *refresh_timer;
+        QTimer *poll_timer;
+        const int refresh_delay = 1000;
+
+        /* live brightness: newest value wins, one request in flight */
+        QTimer *brightness_timer;
+        const int brightness_interval = 100;
+        int brightness_pending = -1;
+        int brightness_sent = -1;
+        bool brightness_in_flight = false;
+        quint64 brightness_trace = 0;
+
+        HueTask<void> runRegistration();
         void readRegistration(QString ret);
+        void mergeStatus(QString section, QJsonObject json);
+        void putExecution(const char *key, QJsonValue value);
 
     signals:
         void registrationFailed();
@@ -69,6 +135,8 @@ class HueSyncbox : public HueDevice
 
     private slots:
         void syncboxRequestFinished(const QVariant type, const QString ret);
-        void tryRegister();
+        void syncboxRequestFailed(const QVariant type);
+        void poll();
+        void sendBrightness();
 };
 #endif // HUESYNCBOX_H
\ No newline at end of file
@@ -0,0 +1,91 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUETRACER_H
+#define HUETRACER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+struct HueTrace {
+    QString name;
+    QSet<QString> targets; // resources whose events close the trace
+    qint64 start_us = 0;
+    qint64 reply_us = 0; // last response of the bridge
+    int requests = 0;
+};
+
+/*
+ Traces a command from the click to the event that reports its result.
+ A trace is opened by the widget, carried by the requests sent while it
+ is the current one and closed when every target resource has reported
+ back. Finished spans can be exported as Chrome trace JSON, readable by
+ chrome://tracing and Perfetto.
+*/
+class HueTracer : public QObject
+{
+    Q_OBJECT
+    public:
+        static HueTracer *instance();
+
+        qint64 now();
+
+        quint64 begin(const QString &name, const QStringList &targets);
+        static quint64 current();
+        static void setCurrent(quint64 trace);
+
+        void requestSent(quint64 trace, const QString &endpoint);
+        void requestFinished(quint64 trace, const QString &endpoint, qint64 sent_us, bool ok);
+        void resourceUpdated(const QString &rid);
+        void drop(quint64 trace);
+        void cancelTarget(quint64 trace, const QString &rid);
+
+        QJsonObject chromeTrace();
+        bool exportChromeTrace(const QString &path);
+
+    private:
+        explicit HueTracer(QObject *parent = nullptr);
+
+        const qint64 trace_timeout_us = 10000000;
+        const int spans_max = 20000;
+
+        QMutex mutex;
+        QElapsedTimer clock;
+        quint64 last_trace = 0;
+        QHash<quint64, HueTrace> open_traces;
+        QList<QJsonObject> spans; // finished spans, the oldest are dropped first
+
+        void addSpan(quint64 trace, const QString &name, qint64 start_us, qint64 end_us, QJsonObject args = QJsonObject());
+        void closeTrace(quint64 trace, qint64 end_us, QString result);
+};
+
+/* makes a trace current until the end of the scope */
+class HueTraceScope
+{
+    public:
+        explicit HueTraceScope(quint64 trace);
+        ~HueTraceScope();
+
+    private:
+        quint64 previous;
+};
+#endif // HUETRACER_H
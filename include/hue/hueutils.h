@@ -19,10 +19,23 @@
 #define HUEUTILS_H
 
 #include <QString>
+#include <QByteArray>
 #include <QJsonArray>
 #include <QJsonObject>
 
 QJsonArray QString2QJsonArray(QString &data);
 QJsonObject QString2QJsonObject(QString &data);
 
+/*
+ Convert RGB (0.0 - 1.0) to the CIE xy used by the lights
+ https://developers.meethue.com/develop/application-design-guidance/color-conversion-formulas-rgb-to-xy-and-back/#Color-rgb-to-xy
+*/
+void hueRgbToXY(double red, double green, double blue, double &x, double &y);
+
+/*
+ Serialize a CLIP v2 gradient PUT body straight from interleaved xy pairs
+ {"on":{"on":true},"gradient":{"points":[{"color":{"xy":{"x":..,"y":..}}},..]}}
+*/
+QByteArray hueGradientBody(const float *xy, int points);
+
 #endif // HUEUTILS_H
\ No newline at end of file
@@ -50,6 +50,7 @@ class MenuButton : public QPushButton
         bool has_switch;
         QLabel *label;
         QLabel *icon;
+        QLabel *preview = nullptr;
         MenuSlider *slider;
         MenuSwitch *button_switch;
         bool combined_state = false;
@@ -58,6 +59,7 @@ class MenuButton : public QPushButton
         bool manual_set = false;
         int my_border = 5;
         int points_icon_size = 24;
+        int preview_dot_size = 10;
 
     public slots:
         void pointClicked();
@@ -78,9 +80,11 @@ class MenuButton : public QPushButton
         void setIcon(QString icon_name);
         void setColor(QColor color);
         void setColorsPoints(QVarLengthArray<QColor> colors);
+        void setPreviewColors(QVarLengthArray<QColor> colors);
         void setSwitch(bool on);
         void setSlider(int value);
         void setSliderMax(int value);
+        void setSliderTracking(bool enable);
         void setCombined(bool comb = true, bool all = false);
         bool combined();
         bool combinedAll();
@@ -0,0 +1,244 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QPointer>
+#include <QTimer>
+
+#include "hueasync.h"
+#include "hueutils.h"
+
+QJsonObject HueReply::object() const
+{
+    QString json = data;
+    return QString2QJsonObject(json);
+}
+
+QJsonArray HueReply::array() const
+{
+    QString json = data;
+    return QString2QJsonArray(json);
+}
+
+HueRequest::HueRequest(HueDevice *device, quint64 serial): state(std::make_shared<State>())
+{
+    std::shared_ptr<State> shared = state;
+
+    shared->completed = QObject::connect(device, &HueDevice::requestCompleted, device, [shared, serial](quint64 completed, bool ok, const QString ret) {
+        if (completed != serial) {
+            return;
+        }
+
+        HueReply reply;
+        reply.ok = ok;
+        reply.data = ret;
+
+        complete(shared, reply);
+    });
+
+    shared->destroyed = QObject::connect(device, &QObject::destroyed, [shared]() {
+        complete(shared, HueReply());
+    });
+}
+
+void HueRequest::complete(std::shared_ptr<State> state, HueReply reply)
+{
+    if (state->done) {
+        return;
+    }
+
+    state->done = true;
+    state->reply = reply;
+
+    QObject::disconnect(state->completed);
+    QObject::disconnect(state->destroyed);
+
+    if (state->continuation) {
+        state->continuation.resume();
+    }
+}
+
+bool HueRequest::await_ready() const noexcept
+{
+    return state->done;
+}
+
+void HueRequest::await_suspend(std::coroutine_handle<> handle)
+{
+    state->continuation = handle;
+}
+
+HueReply HueRequest::await_resume()
+{
+    return state->reply;
+}
+
+HueDelay::HueDelay(int msec)
+{
+    delay = msec;
+}
+
+bool HueDelay::await_ready() const noexcept
+{
+    return delay <= 0;
+}
+
+void HueDelay::await_suspend(std::coroutine_handle<> handle)
+{
+    QTimer::singleShot(delay, [handle]() {
+        handle.resume();
+    });
+}
+
+HueAsyncBridge::HueAsyncBridge(HueBridge *hue_bridge)
+{
+    bridge = hue_bridge;
+}
+
+HueRequest HueAsyncBridge::createUser()
+{
+    return HueRequest(bridge, bridge->createUser());
+}
+
+HueRequest HueAsyncBridge::getStatus()
+{
+    return HueRequest(bridge, bridge->getStatus());
+}
+
+HueRequest HueAsyncBridge::getResource(QString type)
+{
+    return HueRequest(bridge, bridge->getResource(type));
+}
+
+HueRequest HueAsyncBridge::getLight(QString id)
+{
+    return HueRequest(bridge, bridge->getLight(id));
+}
+
+HueRequest HueAsyncBridge::putLight(QString id, QByteArray data)
+{
+    return HueRequest(bridge, bridge->putLight(id, data));
+}
+
+HueRequest HueAsyncBridge::putGroupedLight(QString id, QByteArray data)
+{
+    return HueRequest(bridge, bridge->putGroupedLight(id, data));
+}
+
+HueRequest HueAsyncBridge::putScene(QString id, QByteArray data)
+{
+    return HueRequest(bridge, bridge->putScene(id, data));
+}
+
+HueAsyncSyncbox::HueAsyncSyncbox(HueSyncbox *hue_syncbox)
+{
+    syncbox = hue_syncbox;
+}
+
+HueRequest HueAsyncSyncbox::postRegistration()
+{
+    return HueRequest(syncbox, syncbox->postRegistration());
+}
+
+HueRequest HueAsyncSyncbox::getStatus()
+{
+    return HueRequest(syncbox, syncbox->getStatus());
+}
+
+HueRequest HueAsyncSyncbox::getExecution()
+{
+    return HueRequest(syncbox, syncbox->getExecution());
+}
+
+HueRequest HueAsyncSyncbox::setExecution(QJsonObject json)
+{
+    return HueRequest(syncbox, syncbox->setExecution(json));
+}
+
+HueTask<bool> huePairBridge(HueBridge *hue_bridge, int attempts, int interval)
+{
+    QPointer<HueBridge> bridge = hue_bridge;
+
+    /* the user has to press the link button, the bridge refuses until then */
+    for (int i = 0; i < attempts; ++i) {
+        if (bridge.isNull()) {
+            co_return false;
+        }
+
+        HueReply reply = co_await HueAsyncBridge(bridge).createUser();
+
+        if (bridge.isNull()) {
+            co_return false;
+        }
+
+        // the bridge read the same reply before, a success set the user name
+        if (reply.ok && bridge->userName() != "") {
+            co_return true;
+        }
+
+        co_await HueDelay(interval);
+    }
+
+    co_return false;
+}
+
+HueTask<bool> hueRegisterSyncbox(HueSyncbox *hue_syncbox, int attempts, int interval)
+{
+    QPointer<HueSyncbox> syncbox = hue_syncbox;
+
+    /* the registration is accepted after the button on the syncbox is held */
+    for (int i = 0; i < attempts; ++i) {
+        if (syncbox.isNull()) {
+            co_return false;
+        }
+
+        HueReply reply = co_await HueAsyncSyncbox(syncbox).postRegistration();
+
+        if (syncbox.isNull()) {
+            co_return false;
+        }
+
+        if (reply.ok && reply.object().contains("accessToken")) {
+            co_return true;
+        }
+
+        co_await HueDelay(interval);
+    }
+
+    co_return false;
+}
+
+HueTask<QHash<QString, QJsonObject>> hueFetchResources(HueBridge *hue_bridge, QStringList types)
+{
+    HueAsyncBridge bridge(hue_bridge);
+    QList<HueRequest> requests;
+    QHash<QString, QJsonObject> resources;
+
+    // every request is sent before the first one is awaited
+    for (const QString &type : types) {
+        requests.append(bridge.getResource(type));
+    }
+
+    for (int i = 0; i < requests.size(); ++i) {
+        HueReply reply = co_await requests[i];
+
+        if (reply.ok) {
+            resources[types[i]] = reply.object();
+        }
+    }
+
+    co_return resources;
+}
@@ -23,6 +23,9 @@
 
 #include "hueutils.h"
 #include "huebridge.h"
+#include "huecommandqueue.h"
+#include "huejson.h"
+#include "huemetrics.h"
 
 const QByteArray pem_cert("-----BEGIN CERTIFICATE-----\n\
 MIICMjCCAdigAwIBAgIUO7FSLbaxikuXAljzVaurLXWmFw4wCgYIKoZIzj0EAwIw\n\
@@ -45,14 +48,23 @@ HueBridge::HueBridge(QString ip, HueDevice *parent): HueDevice(ip, parent)
     ca_certificates << QSslCertificate(pem_cert);
     ssl_configuration.setCaCertificates(ca_certificates);
 
-    event_manager = new QNetworkAccessManager();
-    connect(event_manager, SIGNAL(sslErrors(QNetworkReply*,QList<QSslError>)), this, SLOT(onSslError(QNetworkReply*, QList<QSslError>)));
-    connect(event_manager, SIGNAL(finished(QNetworkReply*)), this, SLOT(eventRequestFinished(QNetworkReply*)));
+    event_worker = new HueNetworkWorker(true);
+    connect(this, SIGNAL(eventStreamRequest(HueWorkerRequest)), event_worker, SLOT(send(HueWorkerRequest)));
+    connect(event_worker, SIGNAL(finished(HueWorkerReply)), this, SLOT(eventRequestFinished(HueWorkerReply)));
 
     connect(this, SIGNAL(requestDeviceFinished(const QVariant, const QString)), this, SLOT(bridgeRequestFinished(const QVariant, const QString)));
+    connect(this, SIGNAL(requestDeviceFailed(const QVariant)), this, SLOT(bridgeRequestFailed(const QVariant)));
 
     connect(this, SIGNAL(connected()), this, SLOT(startEventStream()));
     connect(this, SIGNAL(disconnected()), this, SLOT(stopEventStream()));
+
+    command_queue = new HueCommandQueue(this);
+    connect(command_queue, SIGNAL(batchFinished(quint64, bool)), this, SIGNAL(batchFinished(quint64, bool)));
+}
+
+HueBridge::~HueBridge()
+{
+    event_worker->deleteLater();
 }
 
 void HueBridge::setUserName(QString s)
@@ -61,12 +73,22 @@ void HueBridge::setUserName(QString s)
 
     setSslConfiguration(ssl_configuration);
 
-    request_headers.clear();
-    request_headers.append(createHeader("hue-application-key", user_name));
+    clearRequestHeaders();
+    setRequestHeader("hue-application-key", user_name);
 
     setKnown();
 }
 
+QString HueBridge::userName()
+{
+    return user_name;
+}
+
+QString HueBridge::clientKey()
+{
+    return client_key;
+}
+
 bool HueBridge::updateBridgeInfo(QJsonObject data)
 {
     bool changed = false;
@@ -92,6 +114,13 @@ bool HueBridge::updateBridgeInfo(QJsonObject data)
         }
     }
 
+    if (data.contains("mdnsname")) {
+        if (mdnsName() != data["mdnsname"].toString()) {
+            setMdnsName(data["mdnsname"].toString());
+            changed = true;
+        }
+    }
+
     if (data.contains("username")) {
         if (user_name != data["username"].toString()) {
             setUserName(data["username"].toString());
@@ -117,13 +146,14 @@ QJsonObject HueBridge::dumpBridge()
     json["bridgeid"] = id();
     json["name"] = deviceName();
     json["internalipaddress"] = ip();
+    json["mdnsname"] = mdnsName();
     json["username"] = user_name;
     json["clientkey"] = client_key;
 
     return json;
 }
 
-void HueBridge::createUser()
+quint64 HueBridge::createUser()
 {
     QString user = "hue-qt#";
     user += QHostInfo::localHostName().left(15);
@@ -133,11 +163,11 @@ void HueBridge::createUser()
     json["generateclientkey"] = true;
 
     QJsonDocument doc(json);
-    QByteArray bytes = doc.toJson();
+    QByteArray bytes = doc.toJson(QJsonDocument::Compact);
 
-    QString url = url_api_v1.arg(ip());
+    QUrl url = deviceUrl(path_api_v1, false);
 
-    sendRequestPOST(url, (QNetworkRequest::Attribute) req_create_user, bytes);
+    return sendRequestPOST(url, (QNetworkRequest::Attribute) req_create_user, bytes);
 }
 
 void HueBridge::runEventStream()
@@ -146,23 +176,13 @@ void HueBridge::runEventStream()
         return;
     }
 
-    QString url = url_api_v2_event_stream.arg(ip());
-
-    QNetworkRequest request;
-    request.setSslConfiguration(ssl_configuration);
-    request.setPeerVerifyName(id());
-    request.setUrl(QUrl(url));
+    QNetworkRequest request = createRequest(deviceUrl(path_api_v2_event_stream));
     request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork); // Events shouldn't be cached
 
-    foreach (const QStringList &header, request_headers) {
-        if (header.isEmpty()) {
-            break;
-        }
-
-        request.setRawHeader(header.at(0).toUtf8(), header.at(1).toUtf8());
-    }
+    HueWorkerRequest work;
+    work.request = request;
 
-    event_manager->get(request);
+    emit eventStreamRequest(work);
 }
 
 
@@ -178,11 +198,12 @@ void HueBridge::stopEventStream()
     events_running = false;
 }
 
-void HueBridge::eventRequestFinished(QNetworkReply *reply)
+void HueBridge::eventRequestFinished(HueWorkerReply reply)
 {
-    if (reply->error()) {
+    if (!reply.ok) {
         if(event_retries < 10) {
-            qWarning() << "request reply on event stream error: " + reply->errorString();
+            qWarning() << "request reply on event stream error: " + reply.error;
+            HueMetrics::instance()->addReconnect(ip() + "/event_stream");
             event_retries++;
             runEventStream();
             return;
@@ -192,18 +213,128 @@ void HueBridge::eventRequestFinished(QNetworkReply *reply)
         }
     }
 
-    QString ret = reply->readAll();
-
-    QJsonArray json_array = QString2QJsonArray(ret);
+    QJsonArray json_array = reply.json.array();
 
     if (json_array.size() > 0) {
-        emit events(json_array);
+        // subscribers reading the snapshot see the batch they are told about
+        emit snapshotPublished(state_store.applyEvents(json_array));
+        dispatchEvents(json_array);
     }
 
     event_retries = 0;
     runEventStream();
 }
 
+HueEventSubscription *HueBridge::subscribe(QStringList types, QStringList rids, QObject *owner)
+{
+    HueEventSubscription *subscription = new HueEventSubscription(types, rids, owner != nullptr ? owner : this);
+    connect(subscription, SIGNAL(destroyed(QObject*)), this, SLOT(subscriptionDestroyed(QObject*)));
+
+    if (!rids.isEmpty()) {
+        for (const QString &rid : rids) {
+            subscribed_rids.insert(rid, subscription);
+        }
+    } else if (!types.isEmpty()) {
+        for (const QString &type : types) {
+            subscribed_types.insert(type, subscription);
+        }
+    } else {
+        subscribed_all.append(subscription);
+    }
+
+    return subscription;
+}
+
+QList<HueEventSubscription*> HueBridge::subscribers(const QString &id, const QString &type)
+{
+    QList<HueEventSubscription*> candidates = subscribed_all;
+    candidates.append(subscribed_rids.values(id));
+    candidates.append(subscribed_types.values(type));
+
+    QList<HueEventSubscription*> list;
+    for (HueEventSubscription *subscription : candidates) {
+        if (subscription->matches(id, type) && !list.contains(subscription)) {
+            list.append(subscription);
+        }
+    }
+
+    return list;
+}
+
+void HueBridge::unsubscribe(HueEventSubscription *subscription)
+{
+    subscriptionDestroyed(subscription);
+    subscription->deleteLater();
+}
+
+void HueBridge::subscriptionDestroyed(QObject *subscription)
+{
+    HueEventSubscription *removed = static_cast<HueEventSubscription*>(subscription);
+
+    QMutableHashIterator<QString, HueEventSubscription*> rid(subscribed_rids);
+    while (rid.hasNext()) {
+        if (rid.next().value() == removed) {
+            rid.remove();
+        }
+    }
+
+    QMutableHashIterator<QString, HueEventSubscription*> type(subscribed_types);
+    while (type.hasNext()) {
+        if (type.next().value() == removed) {
+            type.remove();
+        }
+    }
+
+    subscribed_all.removeAll(removed);
+}
+
+void HueBridge::dispatchEvents(const QJsonArray &json_array)
+{
+    QList<HueEventSubscription*> notified;
+
+    for (int i = 0; i < json_array.size(); ++i) {
+        QJsonObject json = json_array[i].toObject();
+        HueEventTypes event_type = hueEventType(json["type"].toString());
+        QDateTime created;
+
+        QJsonArray json_data = json["data"].toArray();
+        for (int j = 0; j < json_data.size(); ++j) {
+            QJsonObject json_item = json_data[j].toObject();
+            QString id = json_item["id"].toString();
+            QString type = json_item["type"].toString();
+
+            QList<HueEventSubscription*> targets = subscribers(id, type);
+
+            // nobody listens, nothing more is decoded
+            if (targets.isEmpty()) {
+                continue;
+            }
+
+            if (!created.isValid()) {
+                created = QDateTime::fromString(json["creationtime"].toString(), Qt::ISODate);
+
+                if (created.isValid()) {
+                    HueMetrics::instance()->addEventLag(created.msecsTo(QDateTime::currentDateTimeUtc()));
+                }
+            }
+
+            HueEvent event = hueDecodeEvent(event_type, created, json_item);
+
+            for (HueEventSubscription *subscription : targets) {
+                emit subscription->received(event);
+
+                if (!notified.contains(subscription)) {
+                    notified.append(subscription);
+                }
+            }
+        }
+    }
+
+    for (HueEventSubscription *subscription : notified) {
+        emit subscription->batchFinished();
+    }
+}
+
 void HueBridge::bridgeRequestFinished(const QVariant type, const QString ret)
 {
     HueBridgeRequestTypes hue_type = (HueBridgeRequestTypes) type.toInt();
@@ -222,16 +353,56 @@ void HueBridge::bridgeRequestFinished(const QVariant type, const QString ret)
 
         case req_bridge_status_v2:
             {
-                QString device_status = ret;
-                QJsonObject json = QString2QJsonObject(device_status);
+                QJsonObject json = requestJson().object();
+                if (json.contains("data")) {
+                    emit snapshotPublished(state_store.replaceAll(json["data"].toArray()));
+                }
                 emit statusV2(json);
                 break;
             }
 
+        case req_bridge_resource_v2:
+            {
+                QJsonObject json = requestJson().object();
+                QString type = requestTag().toString();
+
+                // a single resource is asked as "<type>/<id>"
+                if (json.contains("data") && type.contains('/')) {
+                    emit snapshotPublished(state_store.upsert(json["data"].toArray()));
+                } else if (json.contains("data")) {
+                    emit snapshotPublished(state_store.replaceType(type, json["data"].toArray()));
+                }
+                emit resourceV2(type, json);
+                break;
+            }
+
+        case req_bridge_put_v2:
+            {
+                QJsonObject json = requestJson().object();
+                if (!json["errors"].toArray().isEmpty()) {
+                    qWarning() << json["errors"].toArray()[0].toObject()["description"].toString();
+                    emit commandFailed(requestTag().toString());
+                }
+                break;
+            }
+
+        case req_bridge_entertainment_v2:
+            {
+                QJsonObject json = requestJson().object();
+                emit entertainmentConfiguration(json);
+                break;
+            }
+
+        case req_bridge_entertainment_put_v2:
+            {
+                QJsonObject json = requestJson().object();
+                emit entertainmentConfigurationUpdated(json);
+                break;
+            }
+
         case req_bridge_config_v1:
             {
-                QString device_config = ret;
-                QJsonObject json = QString2QJsonObject(device_config);
+                QJsonObject json = requestJson().object();
                 if (updateBridgeInfo(json)) {
                     emit infoUpdated();
                 }
@@ -245,6 +416,15 @@ void HueBridge::bridgeRequestFinished(const QVariant type, const QString ret)
     }
 }
 
+void HueBridge::bridgeRequestFailed(const QVariant type)
+{
+    HueBridgeRequestTypes hue_type = (HueBridgeRequestTypes) type.toInt();
+
+    if (hue_type == req_bridge_put_v2) {
+        emit commandFailed(requestTag().toString());
+    }
+}
+
 void HueBridge::readCreateUser(QString ret)
 {
     QJsonArray json_array = QString2QJsonArray(ret);
@@ -273,44 +453,152 @@ void HueBridge::readCreateUser(QString ret)
     }
 }
 
-void HueBridge::getStatus1()
+quint64 HueBridge::getStatus1()
+{
+    QUrl url = deviceUrl(path_api_v1 + "/" + user_name + "/", false);
+    return sendRequestGET(url, (QNetworkRequest::Attribute) req_bridge_status_v1);
+}
+
+quint64 HueBridge::getConfig1()
+{
+    QUrl url = deviceUrl(path_api_v1 + "/" + user_name + "/config", false);
+    return sendRequestGET(url, (QNetworkRequest::Attribute) req_bridge_config_v1);
+}
+
+quint64 HueBridge::getStatus()
+{
+    QUrl url = deviceUrl(path_api_v2);
+    return sendRequestGET(url, (QNetworkRequest::Attribute) req_bridge_status_v2);
+}
+
+quint64 HueBridge::getResource(QString type)
+{
+    QUrl url = deviceUrl(path_api_v2 + "/" + type);
+    return sendRequestGET(url, (QNetworkRequest::Attribute) req_bridge_resource_v2, type);
+}
+
+quint64 HueBridge::getLight(QString light_id)
+{
+    return getResource("light/" + light_id);
+}
+
+void HueBridge::getResources(QStringList types)
+{
+    /* the requests run concurrently, every type is answered on its own */
+    for (const QString &type : types) {
+        getResource(type);
+    }
+}
+
+quint64 HueBridge::putLight(QString light_id, QJsonObject json)
 {
-    QString url = url_api_v1_user.arg(ip(), user_name, "");
-    sendRequestGET(url, (QNetworkRequest::Attribute) req_bridge_status_v1);
+    QUrl url = deviceUrl(path_api_v2 + "/light/" + light_id);
+    QJsonDocument doc(json);
+    QByteArray data = doc.toJson(QJsonDocument::Compact);
+    return sendRequestPUT(url, (QNetworkRequest::Attribute) req_bridge_put_v2 , data, light_id);
 }
 
-void HueBridge::getConfig1()
+quint64 HueBridge::putLight(QString light_id, QByteArray data)
 {
-    QString url = url_api_v1_user.arg(ip(), user_name, "config");
-    sendRequestGET(url, (QNetworkRequest::Attribute) req_bridge_config_v1);
+    QUrl url = deviceUrl(path_api_v2 + "/light/" + light_id);
+    return sendRequestPUT(url, (QNetworkRequest::Attribute) req_bridge_put_v2 , data, light_id);
 }
 
-void HueBridge::getStatus()
+quint64 HueBridge::putGroupedLight(QString group_id, QByteArray data)
 {
-    QString url = url_api_v2.arg(ip());
-    sendRequestGET(url, (QNetworkRequest::Attribute) req_bridge_status_v2);
+    QUrl url = deviceUrl(path_api_v2 + "/grouped_light/" + group_id);
+    return sendRequestPUT(url, (QNetworkRequest::Attribute) req_bridge_put_v2 , data, group_id);
 }
 
-void HueBridge::putLight(QString light_id, QJsonObject json)
+quint64 HueBridge::putGroupedLight(QString group_id, QJsonObject json)
 {
-    QString url = url_api_v2.arg(ip()) + "/light/" + light_id;
+    QUrl url = deviceUrl(path_api_v2 + "/grouped_light/" + group_id);
     QJsonDocument doc(json);
-    QByteArray data = doc.toJson();
-    sendRequestPUT(url, (QNetworkRequest::Attribute) req_bridge_put_v2 , data);
+    QByteArray data = doc.toJson(QJsonDocument::Compact);
+    return sendRequestPUT(url, (QNetworkRequest::Attribute) req_bridge_put_v2 , data, group_id);
 }
 
-void HueBridge::putGroupedLight(QString group_id, QJsonObject json)
+quint64 HueBridge::putScene(QString scene_id, QJsonObject json)
 {
-    QString url = url_api_v2.arg(ip()) + "/grouped_light/" + group_id;
+    QUrl url = deviceUrl(path_api_v2 + "/scene/" + scene_id);
     QJsonDocument doc(json);
-    QByteArray data = doc.toJson();
-    sendRequestPUT(url, (QNetworkRequest::Attribute) req_bridge_put_v2 , data);
+    QByteArray data = doc.toJson(QJsonDocument::Compact);
+    return sendRequestPUT(url, (QNetworkRequest::Attribute) req_bridge_put_v2 , data, scene_id);
+}
+
+quint64 HueBridge::putScene(QString scene_id, QByteArray data)
+{
+    QUrl url = deviceUrl(path_api_v2 + "/scene/" + scene_id);
+    return sendRequestPUT(url, (QNetworkRequest::Attribute) req_bridge_put_v2 , data, scene_id);
+}
+
+std::shared_ptr<const HueSnapshot> HueBridge::snapshot()
+{
+    return state_store.snapshot();
+}
+
+HueCommandQueue *HueBridge::commands()
+{
+    return command_queue;
+}
+
+quint64 HueBridge::recallScenes(QStringList scene_ids, QString action)
+{
+    std::shared_ptr<const HueSnapshot> current = snapshot();
+    QList<HueQueuedCommand> batch;
+
+    QByteArray data = hueRecallBody(action.toLatin1().constData());
+
+    for (const QString &scene_id : scene_ids) {
+        HueQueuedCommand command;
+        command.type = command_scene;
+        command.id = scene_id;
+        command.data = data;
+
+        /* one recall per group, the same key the ui uses for a clicked scene */
+        QString group_id = current->resource(scene_id)["group"].toObject()["rid"].toString();
+        command.key = "scene/" + (group_id != "" ? group_id : scene_id);
+
+        batch.append(command);
+    }
+
+    return command_queue->enqueueBatch(batch);
+}
+
+quint64 HueBridge::switchGroups(QStringList grouped_light_ids, bool on)
+{
+    QList<HueQueuedCommand> batch;
+    QByteArray data = hueOnBody(on);
+
+    for (const QString &grouped_light_id : grouped_light_ids) {
+        HueQueuedCommand command;
+        command.type = command_grouped_light;
+        command.id = grouped_light_id;
+        command.data = data;
+        command.key = "on/" + grouped_light_id;
+
+        batch.append(command);
+    }
+
+    return command_queue->enqueueBatch(batch);
+}
+
+quint64 HueBridge::getEntertainmentConfiguration(QString configuration_id)
+{
+    QString path = path_api_v2 + "/entertainment_configuration";
+    if (configuration_id != "") {
+        path += "/" + configuration_id;
+    }
+
+    QUrl url = deviceUrl(path);
+
+    return sendRequestGET(url, (QNetworkRequest::Attribute) req_bridge_entertainment_v2);
 }
 
-void HueBridge::putScene(QString scene_id, QJsonObject json)
+quint64 HueBridge::putEntertainmentConfiguration(QString configuration_id, QJsonObject json)
 {
-    QString url = url_api_v2.arg(ip()) + "/scene/" + scene_id;
+    QUrl url = deviceUrl(path_api_v2 + "/entertainment_configuration/" + configuration_id);
     QJsonDocument doc(json);
-    QByteArray data = doc.toJson();
-    sendRequestPUT(url, (QNetworkRequest::Attribute) req_bridge_put_v2 , data);
+    QByteArray data = doc.toJson(QJsonDocument::Compact);
+    return sendRequestPUT(url, (QNetworkRequest::Attribute) req_bridge_entertainment_put_v2, data);
 }
\ No newline at end of file
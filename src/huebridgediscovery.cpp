@@ -18,6 +18,8 @@
 #include <QDebug>
 #include <QJsonArray>
 #include <QVariant>
+#include <QtNetwork/QNetworkInterface>
+#include <QtNetwork/QNetworkDatagram>
 
 #include "hueutils.h"
 #include "huebridge.h"
@@ -27,21 +29,42 @@ HueBridgeDiscovery::HueBridgeDiscovery(QObject *parent): QObject(parent)
     manager = new QNetworkAccessManager();
     
     connect(manager, SIGNAL(finished(QNetworkReply*)), this, SLOT(requestFinished(QNetworkReply*)));
+
+    mdns = new HueMdnsBrowser(this);
+    connect(mdns, SIGNAL(serviceResolved(QString, QString, quint16, QJsonObject)), this, SLOT(mdnsResolved(QString, QString, quint16, QJsonObject)));
+
+    ssdp_socket = new QUdpSocket(this);
+    ssdp_socket->bind(QHostAddress::AnyIPv4, 0);
+    connect(ssdp_socket, SIGNAL(readyRead()), this, SLOT(readSsdp()));
 }
 
 void HueBridgeDiscovery::requestFinished(QNetworkReply *reply)
 {
+    reply->deleteLater();
+
+    QNetworkRequest request = reply->request();
+
+    HueBridgeRequestTypes hue_type = (HueBridgeRequestTypes) request.attribute(HUEREQUEST_TYPE).toInt();
+
+    if (hue_type == req_discovery_bridge || hue_type == req_discovery_sweep) {
+        probing_ips.remove(request.attribute(HUEREQUEST_IP).toString());
+    }
+
+    if (hue_type == req_discovery_sweep) {
+        sweep_running--;
+        sweepNext();
+    }
+
     if (reply->error()) {
-        qWarning() << "request reply - failed to discover bridge(s)";
+        /* most of the swept addresses are not bridges */
+        if (hue_type != req_discovery_sweep) {
+            qWarning() << "request reply - failed to discover bridge(s)";
+        }
         return;
     }
 
     QString ret = reply->readAll();
 
-    QNetworkRequest request = reply->request();
-
-    HueBridgeRequestTypes hue_type = (HueBridgeRequestTypes) request.attribute(HUEREQUEST_TYPE).toInt();
-
     switch (hue_type) {
         case req_discovery_bridges:
             {
@@ -58,6 +81,14 @@ void HueBridgeDiscovery::requestFinished(QNetworkReply *reply)
                 break;
             }
 
+        case req_discovery_sweep:
+            {
+                QJsonObject object_data = QString2QJsonObject(ret);
+                QString ip = request.attribute(HUEREQUEST_IP).toString();
+                readBridge(object_data, ip, true);
+                break;
+            }
+
         default:
             {
                 break;
@@ -65,8 +96,25 @@ void HueBridgeDiscovery::requestFinished(QNetworkReply *reply)
     }
 }
 
+void HueBridgeDiscovery::setSubnetScan(bool enabled)
+{
+    subnet_scan = enabled;
+}
+
 void HueBridgeDiscovery::discoverBridges()
 {
+    probed_ips.clear();
+    discovered_ids.clear();
+    discovered_bridges.clear();
+
+    /* all sources run in parallel, probes are deduplicated by ip */
+    mdns->browse(mdns_service);
+    searchSsdp();
+
+    if (subnet_scan) {
+        sweepSubnet();
+    }
+
     QNetworkRequest request;
     request.setUrl(QUrl(discover_url));
     request.setAttribute(HUEREQUEST_TYPE, req_discovery_bridges);
@@ -75,15 +123,123 @@ void HueBridgeDiscovery::discoverBridges()
 
 void HueBridgeDiscovery::discoverBridge(QString ip)
 {
+    /* a probe of this ip is on its way, its reply serves this call too */
+    if (probing_ips.contains(ip)) {
+        return;
+    }
+
+    probeBridge(ip, req_discovery_bridge);
+}
+
+void HueBridgeDiscovery::probeBridge(QString ip, HueBridgeRequestTypes type)
+{
+    probed_ips.insert(ip);
+    probing_ips.insert(ip);
+
     QNetworkRequest request;
     QString url = QString("http://%1/api/config").arg(ip);
 
     request.setUrl(QUrl(url));
-    request.setAttribute(HUEREQUEST_TYPE, req_discovery_bridge);
+    request.setTransferTimeout(probe_timeout);
+    request.setAttribute(HUEREQUEST_TYPE, type);
     request.setAttribute(HUEREQUEST_IP, ip);
     manager->get(request);
 }
 
+void HueBridgeDiscovery::mdnsResolved(QString name, QString ip, quint16 port, QJsonObject txt)
+{
+    (void) port;
+    (void) txt;
+
+    mdns_names[ip] = name;
+
+    /* another source was faster, only the name is new */
+    if (discovered_bridges.contains(ip)) {
+        if (discovered_bridges[ip].value("mdnsname").toString() != name) {
+            reportBridge(discovered_bridges[ip], ip);
+        }
+        return;
+    }
+
+    discoverBridge(ip);
+}
+
+void HueBridgeDiscovery::searchSsdp()
+{
+    QByteArray search("M-SEARCH * HTTP/1.1\r\n"
+                      "HOST: 239.255.255.250:1900\r\n"
+                      "MAN: \"ssdp:discover\"\r\n"
+                      "MX: 1\r\n"
+                      "ST: urn:schemas-upnp-org:device:basic:1\r\n"
+                      "\r\n");
+
+    ssdp_socket->writeDatagram(search, ssdp_address, ssdp_port);
+}
+
+void HueBridgeDiscovery::readSsdp()
+{
+    while (ssdp_socket->hasPendingDatagrams()) {
+        QNetworkDatagram datagram = ssdp_socket->receiveDatagram();
+
+        /* bridges announce themselves with the hue-bridgeid header */
+        if (!datagram.data().contains("hue-bridgeid")) {
+            continue;
+        }
+
+        QHostAddress sender(datagram.senderAddress().toIPv4Address());
+        discoverBridge(sender.toString());
+    }
+}
+
+void HueBridgeDiscovery::sweepSubnet()
+{
+    sweep_queue.clear();
+
+    foreach (const QNetworkInterface &network_interface, QNetworkInterface::allInterfaces()) {
+        if (!(network_interface.flags() & QNetworkInterface::IsUp) ||
+            !(network_interface.flags() & QNetworkInterface::IsRunning) ||
+            (network_interface.flags() & QNetworkInterface::IsLoopBack)) {
+
+            continue;
+        }
+
+        foreach (const QNetworkAddressEntry &entry, network_interface.addressEntries()) {
+            if (entry.ip().protocol() != QAbstractSocket::IPv4Protocol) {
+                continue;
+            }
+
+            /* never sweep more than the /24 around our own address */
+            quint32 own = entry.ip().toIPv4Address();
+            quint32 base = own & 0xFFFFFF00;
+
+            for (quint32 host = 1; host < 255; ++host) {
+                if ((base | host) != own) {
+                    sweep_queue.append(QHostAddress(base | host).toString());
+                }
+            }
+        }
+    }
+
+    while (sweep_running < sweep_concurrency && !sweep_queue.isEmpty()) {
+        sweepNext();
+    }
+}
+
+void HueBridgeDiscovery::sweepNext()
+{
+    while (!sweep_queue.isEmpty()) {
+        QString ip = sweep_queue.takeFirst();
+
+        if (probed_ips.contains(ip)) {
+            continue;
+        }
+
+        sweep_running++;
+        probeBridge(ip, req_discovery_sweep);
+        return;
+    }
+}
+
 void HueBridgeDiscovery::readBridges(QJsonArray &data)
 {
     /* It is a bridge */
@@ -103,16 +259,43 @@ void HueBridgeDiscovery::readBridges(QJsonArray &data)
     }
 }
 
-void HueBridgeDiscovery::readBridge(QJsonObject &data, QString ip)
+void HueBridgeDiscovery::readBridge(QJsonObject &data, QString ip, bool require_id)
 {
     /* It is the bridge discovery */
     if (data.size() == 0) {
         return;
     }
 
-    if (data.contains("name") &&
-        data["name"].isString()) {
+    if (!data.contains("name") ||
+        !data["name"].isString()) {
 
-        emit bridgeDiscovered(data, ip);
+        return;
     }
+
+    if (data.contains("bridgeid") &&
+        data["bridgeid"].isString()) {
+
+        QString id = data["bridgeid"].toString();
+
+        /* the same bridge is often reported by several sources */
+        if (discovered_ids.contains(id)) {
+            return;
+        }
+
+        discovered_ids.insert(id);
+    } else if (require_id) {
+        return;
+    }
+
+    reportBridge(data, ip);
+}
+
+void HueBridgeDiscovery::reportBridge(QJsonObject data, QString ip)
+{
+    if (mdns_names.contains(ip)) {
+        data["mdnsname"] = mdns_names[ip];
+    }
+
+    discovered_bridges[ip] = data;
+    emit bridgeDiscovered(data, ip);
 }
@@ -27,21 +27,7 @@ HueBridgeList::HueBridgeList(HueList *parent): HueList(parent)
 
 HueBridge* HueBridgeList::findBridge(QString s)
 {
-    if (s == "") {
-        return NULL;
-    }
-
-    foreach(HueBridge *bridge, list) {
-        if (bridge->id() == s) {
-            return bridge;
-        }
-
-        if (bridge->ip() == s) {
-            return bridge;
-        }
-    }
-
-    return NULL;
+    return static_cast<HueBridge*>(findDevice(s));
 }
 
 HueBridge* HueBridgeList::addBridge(QString ip)
@@ -58,6 +44,7 @@ HueBridge* HueBridgeList::addBridge(QString ip)
     connect(bridge, SIGNAL(infoUpdated()), this, SLOT(needSave()));
 
     list.append(bridge);
+    indexDevice(bridge);
 
     return bridge;
 }
@@ -71,6 +58,7 @@ bool HueBridgeList::removeBridge(QString id)
     }
 
     list.removeOne(bridge);
+    unindexDevice(bridge);
     needSave();
 
     return true;
@@ -0,0 +1,325 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QSet>
+
+#include "huebridge.h"
+#include "huecommandqueue.h"
+#include "huemetrics.h"
+#include "huetracer.h"
+
+HueCommandQueue::HueCommandQueue(HueBridge *hue_bridge): QObject(hue_bridge)
+{
+    bridge = hue_bridge;
+
+    send_timer = new QTimer(this);
+    send_timer->setSingleShot(true);
+    connect(send_timer, SIGNAL(timeout()), this, SLOT(sendNext()));
+
+    connect(bridge, SIGNAL(requestCompleted(quint64, bool, const QString)), this, SLOT(requestCompleted(quint64, bool, const QString)));
+}
+
+void HueCommandQueue::setInterval(int msec)
+{
+    interval = msec;
+}
+
+void HueCommandQueue::setGroupInterval(int msec)
+{
+    group_interval = msec;
+}
+
+int HueCommandQueue::size()
+{
+    return commands.size();
+}
+
+void HueCommandQueue::putLight(QString id, QByteArray data, QString key)
+{
+    HueQueuedCommand command;
+    command.type = command_light;
+    command.id = id;
+    command.data = data;
+    command.key = key;
+
+    enqueue(command);
+}
+
+void HueCommandQueue::putGroupedLight(QString id, QByteArray data, QString key)
+{
+    HueQueuedCommand command;
+    command.type = command_grouped_light;
+    command.id = id;
+    command.data = data;
+    command.key = key;
+
+    enqueue(command);
+}
+
+void HueCommandQueue::putScene(QString id, QByteArray data, QString key)
+{
+    HueQueuedCommand command;
+    command.type = command_scene;
+    command.id = id;
+    command.data = data;
+    command.key = key;
+
+    enqueue(command);
+}
+
+bool HueCommandQueue::supersedes(const HueQueuedCommand &command, const HueQueuedCommand &waiting)
+{
+    if (command.key != "" && waiting.key == command.key) {
+        return true;
+    }
+
+    /* dimming, color and mirek bodies switch on, an off sent later makes them moot */
+    return command.type == waiting.type
+        && command.id == waiting.id
+        && command.data.contains("\"on\":{\"on\":false}")
+        && waiting.data.contains("\"on\":");
+}
+
+void HueCommandQueue::enqueue(HueQueuedCommand command)
+{
+    command.trace = HueTracer::current();
+
+    for (int i = commands.size() - 1; i >= 0; --i) {
+        if (!supersedes(command, commands[i])) {
+            continue;
+        }
+
+        HueQueuedCommand superseded = commands.takeAt(i);
+
+        /* the newer value still completes the batch of the old one */
+        if (command.batch == 0 && superseded.key == command.key) {
+            command.batch = superseded.batch;
+            superseded.batch = 0;
+        }
+
+        settleBatch(superseded.batch, false);
+        dropCommand(superseded);
+    }
+
+    /* at the tail, never ahead of commands queued after the one it replaces */
+    commands.append(command);
+    reportDepth();
+
+    schedule();
+}
+
+quint64 HueCommandQueue::enqueueBatch(QList<HueQueuedCommand> batch_commands)
+{
+    QSet<QString> keys;
+    quint64 trace = HueTracer::current();
+
+    last_batch++;
+
+    /* nothing to wait for, still finished once and never before the caller has the id */
+    if (batch_commands.isEmpty()) {
+        quint64 batch = last_batch;
+        QTimer::singleShot(0, this, [this, batch]() {
+            emit batchFinished(batch, true);
+        });
+
+        return batch;
+    }
+
+    /* within the batch the last command of a key wins */
+    for (int i = batch_commands.size() - 1; i >= 0; --i) {
+        QString key = batch_commands[i].key;
+
+        if (key == "") {
+            continue;
+        }
+
+        if (keys.contains(key)) {
+            batch_commands.removeAt(i);
+        } else {
+            keys.insert(key);
+        }
+    }
+
+    for (int i = commands.size() - 1; i >= 0; --i) {
+        if (keys.contains(commands[i].key)) {
+            HueQueuedCommand replaced = commands.takeAt(i);
+            settleBatch(replaced.batch, false);
+            dropCommand(replaced);
+        }
+    }
+
+    for (HueQueuedCommand &command : batch_commands) {
+        command.trace = trace;
+        command.batch = last_batch;
+        commands.append(command);
+    }
+
+    batches[last_batch].waiting = batch_commands.size();
+    reportDepth();
+
+    schedule();
+
+    return last_batch;
+}
+
+void HueCommandQueue::settleBatch(quint64 batch, bool ok)
+{
+    if (batch == 0 || !batches.contains(batch)) {
+        return;
+    }
+
+    HueCommandBatch &pending = batches[batch];
+    pending.waiting--;
+    pending.ok = pending.ok && ok;
+
+    if (pending.waiting > 0) {
+        return;
+    }
+
+    bool batch_ok = pending.ok;
+    batches.remove(batch);
+
+    emit batchFinished(batch, batch_ok);
+}
+
+void HueCommandQueue::cancel(QString key)
+{
+    for (int i = commands.size() - 1; i >= 0; --i) {
+        if (commands[i].key == key) {
+            HueQueuedCommand cancelled = commands.takeAt(i);
+            settleBatch(cancelled.batch, false);
+            dropCommand(cancelled);
+        }
+    }
+
+    reportDepth();
+}
+
+void HueCommandQueue::clear()
+{
+    QList<HueQueuedCommand> cleared = commands;
+
+    commands.clear();
+
+    for (const HueQueuedCommand &command : cleared) {
+        settleBatch(command.batch, false);
+        dropCommand(command);
+    }
+
+    send_timer->stop();
+    reportDepth();
+}
+
+void HueCommandQueue::dropCommand(const HueQueuedCommand &command)
+{
+    HueMetrics::instance()->addCoalesced("commands/" + bridge->ip());
+
+    if (command.trace == 0) {
+        return;
+    }
+
+    /* a group fan-out shares one trace, only this light stops being awaited */
+    if (command.type == command_light) {
+        HueTracer::instance()->cancelTarget(command.trace, command.id);
+    } else {
+        HueTracer::instance()->drop(command.trace);
+    }
+}
+
+void HueCommandQueue::reportDepth()
+{
+    HueMetrics::instance()->setQueueDepth("commands/" + bridge->ip(), commands.size());
+}
+
+qint64 HueCommandQueue::waitFor(const HueQueuedCommand &command)
+{
+    qint64 wait = 0;
+
+    if (last_send.isValid()) {
+        wait = interval - last_send.elapsed();
+    }
+
+    if (command.type != command_light && last_group_send.isValid()) {
+        wait = qMax(wait, group_interval - last_group_send.elapsed());
+    }
+
+    return qMax(Q_INT64_C(0), wait);
+}
+
+void HueCommandQueue::schedule()
+{
+    if (commands.isEmpty() || send_timer->isActive()) {
+        return;
+    }
+
+    send_timer->start(waitFor(commands.first()));
+}
+
+void HueCommandQueue::sendNext()
+{
+    if (commands.isEmpty()) {
+        return;
+    }
+
+    /* the head may have changed to a group command since the timer started */
+    qint64 wait = waitFor(commands.first());
+    if (wait > 0) {
+        send_timer->start(wait);
+        return;
+    }
+
+    HueQueuedCommand command = commands.takeFirst();
+    reportDepth();
+
+    HueTraceScope trace(command.trace);
+    quint64 serial = 0;
+
+    switch (command.type) {
+        case command_light:
+            serial = bridge->putLight(command.id, command.data);
+            break;
+        case command_grouped_light:
+            serial = bridge->putGroupedLight(command.id, command.data);
+            break;
+        case command_scene:
+            serial = bridge->putScene(command.id, command.data);
+            break;
+    }
+
+    if (command.batch != 0) {
+        batch_serials.insert(serial, command.batch);
+    }
+
+    last_send.start();
+
+    if (command.type != command_light) {
+        last_group_send.start();
+    }
+
+    schedule();
+}
+
+void HueCommandQueue::requestCompleted(quint64 serial, bool ok, const QString ret)
+{
+    (void) ret;
+
+    if (!batch_serials.contains(serial)) {
+        return;
+    }
+
+    settleBatch(batch_serials.take(serial), ok);
+}
@@ -16,25 +16,27 @@
  */
 
 #include "huedevice.h"
+#include "huemetrics.h"
+#include "huetracer.h"
 
 using namespace std;
 
 HueDevice::HueDevice(QString address, QObject *parent): QObject(parent)
 {
     setIp(address);
-    manager = new QNetworkAccessManager();
-    request_headers.clear();
 
-    connect(manager, SIGNAL(sslErrors(QNetworkReply*,QList<QSslError>)), this, SLOT(onSslError(QNetworkReply*, QList<QSslError>)));
-    connect(manager, SIGNAL(finished(QNetworkReply*)), this, SLOT(requestFinished(QNetworkReply*)));
-}
+    /* requests are sent and parsed in the network thread */
+    worker = new HueNetworkWorker();
 
-void HueDevice::onSslError(QNetworkReply* r, QList<QSslError> l) {
-    (void) l;
+    connect(this, SIGNAL(workerRequest(HueWorkerRequest)), worker, SLOT(send(HueWorkerRequest)));
+    connect(worker, SIGNAL(finished(HueWorkerReply)), this, SLOT(requestFinished(HueWorkerReply)));
 
-    if (!use_ssl) {
-        r->ignoreSslErrors();
-    }
+    rebuildRequestTemplate();
+}
+
+HueDevice::~HueDevice()
+{
+    worker->deleteLater();
 }
 
 void HueDevice::setDeviceName(QString s)
@@ -49,7 +51,19 @@ QString HueDevice::deviceName()
 
 void HueDevice::setIp(QString s)
 {
+    QString previous = ip_address;
     ip_address = s;
+
+    base_url_https = QUrl();
+    base_url_https.setScheme("https");
+    base_url_https.setHost(ip_address);
+
+    base_url_http = base_url_https;
+    base_url_http.setScheme("http");
+
+    if (previous != s) {
+        emit ipChanged(previous);
+    }
 }
 
 QString HueDevice::ip()
@@ -57,6 +71,21 @@ QString HueDevice::ip()
     return ip_address;
 }
 
+void HueDevice::setMdnsName(QString s)
+{
+    QString previous = mdns_name;
+    mdns_name = s;
+
+    if (previous != s) {
+        emit mdnsNameChanged(previous);
+    }
+}
+
+QString HueDevice::mdnsName()
+{
+    return mdns_name;
+}
+
 void HueDevice::setKnown()
 {
     paired = true;
@@ -69,7 +98,13 @@ bool HueDevice::known()
 
 void HueDevice::setId(QString s)
 {
+    QString previous = identifier;
     identifier = s;
+
+    if (previous != s) {
+        rebuildRequestTemplate();
+        emit idChanged(previous);
+    }
 }
 
 
@@ -87,132 +122,205 @@ void HueDevice::setSslConfiguration(QSslConfiguration ssl_configuration)
 {
     use_ssl = true;
     ssl_conf = ssl_configuration;
+
+    rebuildRequestTemplate();
 }
 
-QStringList HueDevice::createHeader(QString key, QString value)
+void HueDevice::setRequestHeader(QString key, QString value)
 {
-    QStringList header;
+    QByteArray raw_key = key.toUtf8();
+    QByteArray raw_value = value.toUtf8();
+
+    for (int i = 0; i < raw_headers.size(); ++i) {
+        if (raw_headers[i].first == raw_key) {
+            raw_headers.removeAt(i);
+            break;
+        }
+    }
 
-    header.append(key);
-    header.append(value);
+    raw_headers.append(qMakePair(raw_key, raw_value));
+    request_template.setRawHeader(raw_key, raw_value);
+}
 
-    return header;
+void HueDevice::clearRequestHeaders()
+{
+    raw_headers.clear();
+    rebuildRequestTemplate();
 }
 
-void HueDevice::sendRequestGET(QString url, QNetworkRequest::Attribute type)
+void HueDevice::rebuildRequestTemplate()
 {
-    QNetworkRequest request;
+    request_template = QNetworkRequest();
+    request_template.setAttribute(HUEREQUEST_IGNORE_SSL, !use_ssl);
 
     if (use_ssl) {
-        request.setSslConfiguration(ssl_conf);
-        request.setPeerVerifyName(id());
+        request_template.setSslConfiguration(ssl_conf);
+        request_template.setPeerVerifyName(id());
     }
 
-    request.setUrl(QUrl(url));
-    request.setAttribute(HUEREQUEST_TYPE, type);
-    foreach (const QStringList &header, request_headers) {
-        if (header.isEmpty()) {
-            break;
-        }
-
-        request.setRawHeader(header.at(0).toUtf8(), header.at(1).toUtf8());
+    for (const QPair<QByteArray, QByteArray> &header : raw_headers) {
+        request_template.setRawHeader(header.first, header.second);
     }
+}
 
-    manager->get(request);
+QUrl HueDevice::deviceUrl(const QString &path, bool secure)
+{
+    QUrl url = secure ? base_url_https : base_url_http;
+    url.setPath(path, QUrl::DecodedMode);
+
+    return url;
 }
 
-void HueDevice::sendRequestPUT(QString url, QNetworkRequest::Attribute type, const QByteArray data)
+QNetworkRequest HueDevice::createRequest(const QUrl &url)
 {
-    QNetworkRequest request;
+    QNetworkRequest request = request_template;
+    request.setUrl(url);
 
-    if (use_ssl) {
-        request.setSslConfiguration(ssl_conf);
-        request.setPeerVerifyName(id());
-    }
+    return request;
+}
+
+void HueDevice::startRequest(QNetworkRequest &request, QNetworkRequest::Attribute type)
+{
+    HueMetrics *metrics = HueMetrics::instance();
 
-    request.setUrl(QUrl(url));
     request.setAttribute(HUEREQUEST_TYPE, type);
+    request.setAttribute(HUEREQUEST_SERIAL, ++last_serial);
+    request.setAttribute(HUEREQUEST_START, metrics->now());
+    metrics->requestStarted();
+
+    /* a command being traced carries its trace id to the response */
+    quint64 trace = HueTracer::current();
+    if (trace != 0) {
+        HueTracer *tracer = HueTracer::instance();
+
+        request.setAttribute(HUEREQUEST_TRACE, trace);
+        request.setAttribute(HUEREQUEST_TRACE_SENT, tracer->now());
+        tracer->requestSent(trace, request.url().path());
+    }
+}
 
-    foreach (const QStringList &header, request_headers) {
-        if (header.isEmpty()) {
-            break;
-        }
+quint64 HueDevice::sendRequest(QNetworkRequest &request, QNetworkAccessManager::Operation operation, const QByteArray data)
+{
+    HueWorkerRequest work;
+    work.request = request;
+    work.operation = operation;
+    work.data = data;
 
-        request.setRawHeader(header.at(0).toUtf8(), header.at(1).toUtf8());
-    }
+    emit workerRequest(work);
 
-    manager->put(request, data);
+    return request.attribute(HUEREQUEST_SERIAL).toULongLong();
 }
 
-void HueDevice::sendRequestPOST(QString url, QNetworkRequest::Attribute type, const QByteArray data)
+quint64 HueDevice::sendRequestGET(const QUrl &url, QNetworkRequest::Attribute type, QVariant tag)
 {
-    QNetworkRequest request;
+    QNetworkRequest request = createRequest(url);
+    startRequest(request, type);
 
-    if (use_ssl) {
-        request.setSslConfiguration(ssl_conf);
-        request.setPeerVerifyName(id());
+    if (tag.isValid()) {
+        request.setAttribute(HUEREQUEST_TAG, tag);
     }
 
-    request.setUrl(QUrl(url));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-    request.setAttribute(HUEREQUEST_TYPE, type);
+    return sendRequest(request, QNetworkAccessManager::GetOperation);
+}
 
-    foreach (const QStringList &header, request_headers) {
-        if (header.isEmpty()) {
-            break;
-        }
+quint64 HueDevice::sendRequestPUT(const QUrl &url, QNetworkRequest::Attribute type, const QByteArray data, QVariant tag)
+{
+    QNetworkRequest request = createRequest(url);
+    startRequest(request, type);
 
-        request.setRawHeader(header.at(0).toUtf8(), header.at(1).toUtf8());
+    if (tag.isValid()) {
+        request.setAttribute(HUEREQUEST_TAG, tag);
     }
 
-    manager->post(request, data);
+    return sendRequest(request, QNetworkAccessManager::PutOperation, data);
 }
 
-void HueDevice::sendRequestDELETE(QString url, QNetworkRequest::Attribute type)
+quint64 HueDevice::sendRequestPOST(const QUrl &url, QNetworkRequest::Attribute type, const QByteArray data)
 {
-    QNetworkRequest request;
+    QNetworkRequest request = createRequest(url);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    startRequest(request, type);
 
-    if (use_ssl) {
-        request.setSslConfiguration(ssl_conf);
-        request.setPeerVerifyName(id());
-    }
+    return sendRequest(request, QNetworkAccessManager::PostOperation, data);
+}
 
-    request.setUrl(QUrl(url));
-    request.setAttribute(HUEREQUEST_TYPE, type);
-    foreach (const QStringList &header, request_headers) {
-        if (header.isEmpty()) {
-            break;
-        }
-        request.setRawHeader(header.at(0).toUtf8(), header.at(1).toUtf8());
-    }
+quint64 HueDevice::sendRequestDELETE(const QUrl &url, QNetworkRequest::Attribute type)
+{
+    QNetworkRequest request = createRequest(url);
+    startRequest(request, type);
+
+    return sendRequest(request, QNetworkAccessManager::DeleteOperation);
+}
 
-    manager->deleteResource(request);
+QVariant HueDevice::requestTag()
+{
+    return current_tag;
 }
 
-void HueDevice::requestFinished(QNetworkReply *reply)
+QJsonDocument HueDevice::requestJson()
 {
-    if (reply->error()) {
-        qWarning() << "request reply error: " + reply->errorString();
+    return current_json;
+}
+
+quint64 HueDevice::requestSerial()
+{
+    return current_serial;
+}
+
+void HueDevice::requestFinished(HueWorkerReply reply)
+{
+    QNetworkRequest request = reply.request;
+
+    current_tag = request.attribute(HUEREQUEST_TAG);
+    current_json = reply.json;
+    current_serial = request.attribute(HUEREQUEST_SERIAL).toULongLong();
+
+    QString endpoint = HueMetrics::endpoint(reply.operation, request.url());
+
+    HueMetrics *metrics = HueMetrics::instance();
+    metrics->requestFinished(
+        endpoint,
+        metrics->now() - request.attribute(HUEREQUEST_START).toLongLong(),
+        reply.ok
+    );
+
+    quint64 trace = request.attribute(HUEREQUEST_TRACE).toULongLong();
+    if (trace != 0) {
+        HueTracer::instance()->requestFinished(
+            trace,
+            endpoint,
+            request.attribute(HUEREQUEST_TRACE_SENT).toLongLong(),
+            reply.ok
+        );
+    }
+
+    if (!reply.ok) {
+        qWarning() << "request reply error: " + reply.error;
 
         if (known() && device_connected) {
             emit disconnected();
         }
 
         device_connected = false;
+
+        emit requestDeviceFailed(request.attribute(HUEREQUEST_TYPE));
+        emit requestCompleted(request.attribute(HUEREQUEST_SERIAL).toULongLong(), false, QString());
         return;
     }
 
     if (known() && !device_connected) {
+        if (was_connected) {
+            metrics->addReconnect(ip() + "/device");
+        }
+
         device_connected = true;
+        was_connected = true;
 
         emit connected();
     }
 
-    const QString ret = reply->readAll();
-
-    QNetworkRequest request = reply->request();
-
     const QVariant type = request.attribute(HUEREQUEST_TYPE);
 
-    emit requestDeviceFinished(type, ret);
+    emit requestDeviceFinished(type, reply.body);
+    emit requestCompleted(request.attribute(HUEREQUEST_SERIAL).toULongLong(), true, reply.body);
 }
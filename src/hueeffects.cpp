@@ -0,0 +1,287 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QtMath>
+
+#include "huecommandqueue.h"
+#include "huejson.h"
+#include "hueutils.h"
+#include "hueeffects.h"
+#include "huemetrics.h"
+
+static void hueToRgb(double hue, double &red, double &green, double &blue)
+{
+    double h = hue * 6.0;
+    double f = h - qFloor(h);
+
+    switch (qFloor(h) % 6) {
+        case 0: red = 1.0; green = f; blue = 0.0; break;
+        case 1: red = 1.0 - f; green = 1.0; blue = 0.0; break;
+        case 2: red = 0.0; green = 1.0; blue = f; break;
+        case 3: red = 0.0; green = 1.0 - f; blue = 1.0; break;
+        case 4: red = f; green = 0.0; blue = 1.0; break;
+        default: red = 1.0; green = 0.0; blue = 1.0 - f; break;
+    }
+}
+
+HueEffects::HueEffects(HueBridge *hue_bridge, QObject *parent): QObject(parent)
+{
+    bridge = hue_bridge;
+
+    /* red, green, blue corners of the gamut */
+    palette.append({0.675, 0.322, 1.0});
+    palette.append({0.409, 0.518, 1.0});
+    palette.append({0.167, 0.040, 1.0});
+
+    frame_timer = new QTimer(this);
+    frame_timer->setTimerType(Qt::PreciseTimer);
+    connect(frame_timer, SIGNAL(timeout()), this, SLOT(tick()));
+
+    rest_timer = new QTimer(this);
+    rest_timer->setInterval(rest_interval);
+    connect(rest_timer, SIGNAL(timeout()), this, SLOT(sendRest()));
+}
+
+void HueEffects::setLights(QStringList light_ids)
+{
+    lights = light_ids;
+    rest_pending.clear();
+    rest_next = 0;
+}
+
+void HueEffects::setEntertainment(HueEntertainment *hue_entertainment)
+{
+    entertainment = hue_entertainment;
+}
+
+void HueEffects::setPalette(QVector<HueStreamChannel> colors)
+{
+    if (colors.isEmpty()) {
+        return;
+    }
+
+    palette = colors;
+}
+
+void HueEffects::setBrightness(double value)
+{
+    brightness = qBound(0.0, value, 1.0);
+}
+
+void HueEffects::setPeriod(int msec)
+{
+    period = qMax(100, msec);
+}
+
+void HueEffects::setBudget(int jitter_us, int cpu_us)
+{
+    jitter_budget_us = jitter_us;
+    cpu_budget_us = cpu_us;
+}
+
+HueEffectTypes HueEffects::effect()
+{
+    return running_effect;
+}
+
+HueEffectStats HueEffects::stats()
+{
+    return effect_stats;
+}
+
+void HueEffects::start(HueEffectTypes type, int frames_per_second, quint32 seed)
+{
+    stop();
+
+    if (type == effect_none) {
+        return;
+    }
+
+    running_effect = type;
+    fps = qBound(1, frames_per_second, 50);
+    frame = 0;
+    random.seed(seed);
+    flicker.clear();
+
+    effect_stats = HueEffectStats();
+    jitter_sum_us = 0;
+    cpu_sum_us = 0;
+
+    frame_clock.start();
+    frame_timer->start(1000 / fps);
+    rest_timer->start();
+}
+
+void HueEffects::stop()
+{
+    frame_timer->stop();
+    rest_timer->stop();
+    rest_pending.clear();
+
+    running_effect = effect_none;
+}
+
+bool HueEffects::streamingOutputs()
+{
+    return entertainment != nullptr && entertainment->streaming();
+}
+
+void HueEffects::computeFrame(quint64 frame_number, QVector<HueStreamChannel> &frame_outputs)
+{
+    int count = frame_outputs.size();
+    double cycle = frame_number * 1000.0 / fps / period;
+
+    if (flicker.size() != count) {
+        flicker.fill(0.5, count);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        HueStreamChannel &output = frame_outputs[i];
+        double offset = (double) i / count;
+
+        switch (running_effect) {
+            case effect_color_loop:
+                {
+                    double red, green, blue;
+                    hueToRgb(cycle + offset - qFloor(cycle + offset), red, green, blue);
+                    hueRgbToXY(red, green, blue, output.x, output.y);
+                    output.brightness = brightness;
+                    break;
+                }
+
+            case effect_candle:
+                {
+                    /* smoothed noise around 2000K */
+                    flicker[i] = 0.85 * flicker[i] + 0.15 * random.generateDouble();
+                    output.x = 0.5267;
+                    output.y = 0.4133;
+                    output.brightness = brightness * (0.55 + 0.45 * flicker[i]);
+                    break;
+                }
+
+            case effect_gradient_chase:
+                {
+                    double position = cycle + offset;
+                    position = (position - qFloor(position)) * palette.size();
+
+                    int index = qFloor(position) % palette.size();
+                    double f = position - qFloor(position);
+                    const HueStreamChannel &from = palette[index];
+                    const HueStreamChannel &to = palette[(index + 1) % palette.size()];
+
+                    output.x = from.x + (to.x - from.x) * f;
+                    output.y = from.y + (to.y - from.y) * f;
+                    output.brightness = brightness * (from.brightness + (to.brightness - from.brightness) * f);
+                    break;
+                }
+
+            default:
+                {
+                    break;
+                }
+        }
+    }
+}
+
+void HueEffects::tick()
+{
+    qint64 now_ns = frame_clock.nsecsElapsed();
+    qint64 jitter_us = 0;
+
+    if (frame > 0) {
+        qint64 nominal_ns = frame_timer->interval() * 1000000LL;
+        jitter_us = qAbs(now_ns - last_tick_ns - nominal_ns) / 1000;
+    }
+
+    last_tick_ns = now_ns;
+
+    outputs.resize(streamingOutputs() ? entertainment->channels().size() : lights.size());
+    computeFrame(frame++, outputs);
+    pushFrame();
+
+    qint64 cpu_us = (frame_clock.nsecsElapsed() - now_ns) / 1000;
+
+    effect_stats.frames++;
+    jitter_sum_us += jitter_us;
+    cpu_sum_us += cpu_us;
+    effect_stats.jitter_max_us = qMax(effect_stats.jitter_max_us, jitter_us);
+    effect_stats.cpu_max_us = qMax(effect_stats.cpu_max_us, cpu_us);
+    effect_stats.jitter_mean_us = jitter_sum_us / (qint64) effect_stats.frames;
+    effect_stats.cpu_mean_us = cpu_sum_us / (qint64) effect_stats.frames;
+
+    if ((jitter_budget_us > 0 && jitter_us > jitter_budget_us) ||
+        (cpu_budget_us > 0 && cpu_us > cpu_budget_us)) {
+
+        effect_stats.budget_misses++;
+        emit budgetExceeded(jitter_us, cpu_us);
+    }
+}
+
+void HueEffects::pushFrame()
+{
+    if (streamingOutputs()) {
+        QList<quint8> channels = entertainment->channels();
+
+        for (int i = 0; i < outputs.size() && i < channels.size(); ++i) {
+            entertainment->setChannel(channels[i], outputs[i]);
+        }
+
+        return;
+    }
+
+    /* only the newest value of every light waits for the REST slot */
+    for (int i = 0; i < outputs.size() && i < lights.size(); ++i) {
+        if (rest_pending.contains(lights[i])) {
+            effect_stats.coalesced++;
+            HueMetrics::instance()->addCoalesced("effects_rest");
+        }
+
+        rest_pending[lights[i]] = outputs[i];
+    }
+
+    HueMetrics::instance()->setQueueDepth("effects_rest", rest_pending.size());
+}
+
+void HueEffects::sendRest()
+{
+    if (rest_pending.isEmpty() || streamingOutputs()) {
+        return;
+    }
+
+    /* let the queue drain first, other commands must not wait behind the effect */
+    if (bridge->commands()->size() > 0) {
+        return;
+    }
+
+    for (int k = 0; k < lights.size(); ++k) {
+        int index = (rest_next + k) % lights.size();
+        QString light_id = lights[index];
+
+        if (!rest_pending.contains(light_id)) {
+            continue;
+        }
+
+        HueStreamChannel value = rest_pending.take(light_id);
+        HueMetrics::instance()->setQueueDepth("effects_rest", rest_pending.size());
+        rest_next = index + 1;
+
+        /* the same keys as the light controls, a newer value replaces a waiting one */
+        bridge->commands()->putLight(light_id, hueColorBody(value.x, value.y), "color/" + light_id);
+        bridge->commands()->putLight(light_id, hueDimmingBody(qMax(1.0, value.brightness * 100.0)), "dimming/" + light_id);
+        return;
+    }
+}
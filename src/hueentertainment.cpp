@@ -0,0 +1,313 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QtNetwork/QSslCipher>
+
+#include "hueentertainment.h"
+
+static void appendUint16(QByteArray &frame, double value)
+{
+    quint16 scaled = qRound(qBound(0.0, value, 1.0) * 0xFFFF);
+
+    frame.append((char) (scaled >> 8));
+    frame.append((char) (scaled & 0xFF));
+}
+
+QByteArray hueStreamFrame(QString configuration_id, quint8 sequence, const QMap<quint8, HueStreamChannel> &channels)
+{
+    QByteArray frame;
+    frame.reserve(52 + 7 * channels.size());
+
+    frame.append("HueStream", 9);
+    frame.append((char) 0x02); // version 2.0
+    frame.append((char) 0x00);
+    frame.append((char) sequence);
+    frame.append((char) 0x00); // reserved
+    frame.append((char) 0x00);
+    frame.append((char) 0x01); // colour space xy + brightness
+    frame.append((char) 0x00); // reserved
+    frame.append(configuration_id.toLatin1().leftJustified(36, '\0', true));
+
+    QMapIterator<quint8, HueStreamChannel> channel(channels);
+    while (channel.hasNext()) {
+        channel.next();
+
+        frame.append((char) channel.key());
+        appendUint16(frame, channel.value().x);
+        appendUint16(frame, channel.value().y);
+        appendUint16(frame, channel.value().brightness);
+    }
+
+    return frame;
+}
+
+HueEntertainment::HueEntertainment(HueBridge *hue_bridge, QObject *parent): QObject(parent)
+{
+    bridge = hue_bridge;
+
+    connect(bridge, SIGNAL(entertainmentConfiguration(QJsonObject)), this, SLOT(readConfiguration(QJsonObject)));
+    connect(bridge, SIGNAL(entertainmentConfigurationUpdated(QJsonObject)), this, SLOT(configurationUpdated(QJsonObject)));
+
+    socket = new QUdpSocket(this);
+    connect(socket, SIGNAL(readyRead()), this, SLOT(readDatagrams()));
+
+    frame_timer = new QTimer(this);
+    frame_timer->setTimerType(Qt::PreciseTimer);
+    connect(frame_timer, SIGNAL(timeout()), this, SLOT(sendFrame()));
+
+    setRate(50);
+}
+
+HueEntertainment::~HueEntertainment()
+{
+    if (streaming()) {
+        stop();
+    }
+}
+
+void HueEntertainment::setRate(int hz)
+{
+    hz = qBound(1, hz, 60);
+    frame_timer->setInterval(1000 / hz);
+}
+
+void HueEntertainment::setEndpoint(QString ip, quint16 port)
+{
+    endpoint_ip = ip;
+    endpoint_port = port;
+}
+
+void HueEntertainment::setPskIdentity(QString identity)
+{
+    psk_identity = identity;
+}
+
+QList<quint8> HueEntertainment::channels()
+{
+    return configuration_channels;
+}
+
+QStringList HueEntertainment::lightServices()
+{
+    return configuration_lights;
+}
+
+void HueEntertainment::setChannel(quint8 channel, HueStreamChannel value)
+{
+    if (!frame_channels.contains(channel) && frame_channels.size() >= max_channels) {
+        return;
+    }
+
+    frame_channels[channel] = value;
+}
+
+bool HueEntertainment::streaming()
+{
+    return dtls != nullptr && dtls->isConnectionEncrypted();
+}
+
+void HueEntertainment::start(QString configuration_id)
+{
+    configuration = configuration_id;
+    starting = true;
+
+    bridge->getEntertainmentConfiguration(configuration_id);
+}
+
+void HueEntertainment::readConfiguration(QJsonObject json)
+{
+    if (!starting) {
+        return;
+    }
+
+    QJsonArray json_array = json["data"].toArray();
+
+    for (int i = 0; i < json_array.size(); ++i) {
+        QJsonObject json_item = json_array[i].toObject();
+
+        if (json_item["id"].toString() != configuration) {
+            continue;
+        }
+
+        configuration_channels.clear();
+        QJsonArray json_channels = json_item["channels"].toArray();
+        for (int j = 0; j < json_channels.size(); ++j) {
+            configuration_channels.append(json_channels[j].toObject()["channel_id"].toInt());
+        }
+
+        configuration_lights.clear();
+        QJsonArray json_lights = json_item["light_services"].toArray();
+        for (int j = 0; j < json_lights.size(); ++j) {
+            configuration_lights.append(json_lights[j].toObject()["rid"].toString());
+        }
+
+        QJsonObject json_action;
+        json_action["action"] = "start";
+        bridge->putEntertainmentConfiguration(configuration, json_action);
+        return;
+    }
+
+    starting = false;
+    emit failed("unknown entertainment configuration " + configuration);
+}
+
+void HueEntertainment::configurationUpdated(QJsonObject json)
+{
+    if (!starting) {
+        return;
+    }
+
+    starting = false;
+
+    QJsonArray json_errors = json["errors"].toArray();
+    if (json_errors.size() > 0) {
+        emit failed(json_errors[0].toObject()["description"].toString());
+        return;
+    }
+
+    startStream(configuration);
+}
+
+void HueEntertainment::startStream(QString configuration_id)
+{
+    closeStream();
+
+    configuration = configuration_id;
+
+    QString ip = endpoint_ip != "" ? endpoint_ip : bridge->ip();
+    quint16 port = endpoint_port != 0 ? endpoint_port : stream_port;
+
+    QSslConfiguration dtls_configuration = QSslConfiguration::defaultDtlsConfiguration();
+    dtls_configuration.setProtocol(QSsl::DtlsV1_2);
+    dtls_configuration.setPeerVerifyMode(QSslSocket::VerifyNone);
+    dtls_configuration.setCiphers({QSslCipher("PSK-AES128-GCM-SHA256")});
+
+    dtls = new QDtls(QSslSocket::SslClientMode, this);
+    dtls->setPeer(QHostAddress(ip), port);
+    dtls->setDtlsConfiguration(dtls_configuration);
+    connect(dtls, SIGNAL(pskRequired(QSslPreSharedKeyAuthenticator*)), this, SLOT(pskRequired(QSslPreSharedKeyAuthenticator*)));
+    connect(dtls, SIGNAL(handshakeTimeout()), this, SLOT(handshakeTimeout()));
+
+    socket->connectToHost(QHostAddress(ip), port);
+
+    if (!dtls->doHandshake(socket)) {
+        emit failed(dtls->dtlsErrorString());
+        closeStream();
+    }
+}
+
+void HueEntertainment::stop()
+{
+    /* nothing was started, nothing to report */
+    bool active = dtls != nullptr || configuration != "";
+
+    closeStream();
+
+    if (configuration != "" && endpoint_ip == "") {
+        QJsonObject json_action;
+        json_action["action"] = "stop";
+        bridge->putEntertainmentConfiguration(configuration, json_action);
+    }
+
+    configuration = "";
+    starting = false;
+
+    if (active) {
+        emit stopped();
+    }
+}
+
+void HueEntertainment::closeStream()
+{
+    frame_timer->stop();
+
+    if (dtls != nullptr) {
+        if (dtls->isConnectionEncrypted()) {
+            dtls->shutdown(socket);
+        }
+
+        dtls->deleteLater();
+        dtls = nullptr;
+    }
+
+    socket->abort();
+}
+
+void HueEntertainment::pskRequired(QSslPreSharedKeyAuthenticator *authenticator)
+{
+    /* the application key works as identity, the client key is the hex encoded psk */
+    QString identity = psk_identity != "" ? psk_identity : bridge->userName();
+
+    authenticator->setIdentity(identity.toUtf8());
+    authenticator->setPreSharedKey(QByteArray::fromHex(bridge->clientKey().toLatin1()));
+}
+
+void HueEntertainment::handshakeTimeout()
+{
+    if (dtls != nullptr && !dtls->handleTimeout(socket)) {
+        emit failed(dtls->dtlsErrorString());
+        closeStream();
+    }
+}
+
+void HueEntertainment::readDatagrams()
+{
+    while (socket->hasPendingDatagrams()) {
+        QByteArray datagram(socket->pendingDatagramSize(), Qt::Uninitialized);
+        qint64 size = socket->readDatagram(datagram.data(), datagram.size());
+
+        if (dtls == nullptr || size <= 0) {
+            continue;
+        }
+
+        datagram.resize(size);
+
+        if (dtls->isConnectionEncrypted()) {
+            /* the bridge only sends alerts back */
+            dtls->decryptDatagram(socket, datagram);
+            if (dtls->dtlsError() == QDtlsError::RemoteClosedConnectionError) {
+                closeStream();
+                emit stopped();
+                return;
+            }
+            continue;
+        }
+
+        if (!dtls->doHandshake(socket, datagram)) {
+            emit failed(dtls->dtlsErrorString());
+            closeStream();
+            return;
+        }
+
+        if (dtls->isConnectionEncrypted()) {
+            frame_timer->start();
+            emit started();
+        }
+    }
+}
+
+void HueEntertainment::sendFrame()
+{
+    if (!streaming()) {
+        return;
+    }
+
+    /* the stream is refreshed every tick, the bridge closes it when idle */
+    dtls->writeDatagramEncrypted(socket, hueStreamFrame(configuration, sequence++, frame_channels));
+}
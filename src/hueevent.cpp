@@ -0,0 +1,197 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QHash>
+#include <QPair>
+
+#include "hueevent.h"
+
+HueEventTypes hueEventType(const QString &type)
+{
+    if (type == QLatin1String("update"))
+        return event_update;
+
+    if (type == QLatin1String("add"))
+        return event_add;
+
+    if (type == QLatin1String("delete"))
+        return event_delete;
+
+    return event_error;
+}
+
+void hueMergeUpdate(QJsonObject &target, const QJsonObject &update)
+{
+    for (auto i = update.constBegin(); i != update.constEnd(); ++i) {
+        if (i.value().isObject() && target[i.key()].isObject()) {
+            QJsonObject merged = target[i.key()].toObject();
+            QJsonObject values = i.value().toObject();
+
+            for (auto j = values.constBegin(); j != values.constEnd(); ++j) {
+                merged[j.key()] = j.value();
+            }
+
+            target[i.key()] = merged;
+        } else {
+            target[i.key()] = i.value();
+        }
+    }
+}
+
+/*
+ Folds the light and grouped_light updates of one batch. A light updated
+ several times keeps a single update at the place of its first one,
+ carrying the newest values. Buttons, motion, rotary and other sensor
+ updates are discrete events and pass through untouched. An add or
+ delete ends the folding so the order stays right.
+*/
+QJsonArray hueCompactEvents(const QJsonArray &containers)
+{
+    QList<QJsonObject> kept_containers;
+    QList<QJsonArray> kept_data;
+    QHash<QString, QPair<int, int>> updates; // <resource id, <container, item>>
+
+    for (int i = 0; i < containers.size(); ++i) {
+        QJsonObject container = containers[i].toObject();
+        QJsonArray data = container["data"].toArray();
+
+        if (hueEventType(container["type"].toString()) != event_update) {
+            updates.clear();
+            kept_containers.append(container);
+            kept_data.append(data);
+            continue;
+        }
+
+        /* appended first, a repeated id within this container merges into it */
+        int index = kept_containers.size();
+        kept_containers.append(container);
+        kept_data.append(QJsonArray());
+
+        for (int j = 0; j < data.size(); ++j) {
+            QJsonObject item = data[j].toObject();
+            QString id = item["id"].toString();
+            QString type = item["type"].toString();
+
+            if (type != QLatin1String("light") && type != QLatin1String("grouped_light")) {
+                id = "";
+            }
+
+            if (id != "" && updates.contains(id)) {
+                QPair<int, int> position = updates[id];
+                Q_ASSERT(position.first <= index && position.second < kept_data[position.first].size());
+
+                QJsonObject target = kept_data[position.first][position.second].toObject();
+                hueMergeUpdate(target, item);
+                kept_data[position.first][position.second] = target;
+                continue;
+            }
+
+            if (id != "") {
+                updates[id] = qMakePair(index, int(kept_data[index].size()));
+            }
+
+            kept_data[index].append(item);
+        }
+    }
+
+    QJsonArray compacted;
+    for (int i = 0; i < kept_containers.size(); ++i) {
+        QJsonObject container = kept_containers[i];
+
+        // every update of this one was folded into an earlier one
+        if (kept_data[i].isEmpty() && hueEventType(container["type"].toString()) == event_update) {
+            continue;
+        }
+
+        container["data"] = kept_data[i];
+        compacted.append(container);
+    }
+
+    return compacted;
+}
+
+HueEvent hueDecodeEvent(HueEventTypes event_type, const QDateTime &created, const QJsonObject &json)
+{
+    HueEvent event;
+
+    event.event = event_type;
+    event.created = created;
+    event.id = json["id"].toString();
+    event.type = json["type"].toString();
+    event.owner = json["owner"].toObject()["rid"].toString();
+    event.data = json;
+
+    if (json.contains("on")) {
+        event.has_on = true;
+        event.on = json["on"].toObject()["on"].toBool();
+    }
+
+    if (json.contains("dimming")) {
+        event.has_brightness = true;
+        event.brightness = json["dimming"].toObject()["brightness"].toDouble();
+    }
+
+    if (json.contains("color")) {
+        QJsonObject xy = json["color"].toObject()["xy"].toObject();
+
+        if (!xy.isEmpty()) {
+            event.has_xy = true;
+            event.x = xy["x"].toDouble();
+            event.y = xy["y"].toDouble();
+        }
+    }
+
+    if (json.contains("color_temperature")) {
+        QJsonObject color_temperature = json["color_temperature"].toObject();
+
+        if (color_temperature["mirek_valid"].toBool(true) && color_temperature.contains("mirek")) {
+            event.has_mirek = true;
+            event.mirek = color_temperature["mirek"].toInt();
+        }
+    }
+
+    return event;
+}
+
+HueEventSubscription::HueEventSubscription(QStringList resource_types, QStringList resource_rids, QObject *parent): QObject(parent)
+{
+    filter_types = resource_types;
+    filter_rids = resource_rids;
+}
+
+QStringList HueEventSubscription::types()
+{
+    return filter_types;
+}
+
+QStringList HueEventSubscription::rids()
+{
+    return filter_rids;
+}
+
+bool HueEventSubscription::matches(const QString &id, const QString &type)
+{
+    if (!filter_types.isEmpty() && !filter_types.contains(type)) {
+        return false;
+    }
+
+    if (!filter_rids.isEmpty() && !filter_rids.contains(id)) {
+        return false;
+    }
+
+    return true;
+}
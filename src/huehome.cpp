@@ -0,0 +1,435 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "huecommandqueue.h"
+#include "huejson.h"
+#include "huetracer.h"
+#include "huehome.h"
+
+HueHome::HueHome(HueBridgeList *bridge_list, QObject *parent): QObject(parent)
+{
+    bridges = bridge_list;
+    connect(bridges, SIGNAL(bridgeDataUpdated()), this, SLOT(attachBridges()));
+
+    attachBridges();
+}
+
+void HueHome::attachBridges()
+{
+    QList<HueBridge*> known_bridges = attached.values();
+
+    /* removed bridges take their resources with them */
+    for (HueBridge *bridge : known_bridges) {
+        if (!bridges->list.contains(bridge)) {
+            detachBridge(bridge);
+        }
+    }
+
+    foreach(HueBridge *bridge, bridges->list) {
+        if (!bridge->known() || known_bridges.contains(bridge)) {
+            continue;
+        }
+
+        QStringList types;
+        types << "light" << "grouped_light";
+
+        HueEventSubscription *subscription = bridge->subscribe(types, QStringList(), this);
+        connect(subscription, SIGNAL(received(HueEvent)), this, SLOT(readEvent(HueEvent)));
+        connect(bridge, SIGNAL(statusV2(QJsonObject)), this, SLOT(readStatus(QJsonObject)));
+        connect(bridge, SIGNAL(resourceV2(QString, QJsonObject)), this, SLOT(readResource(QString, QJsonObject)));
+        connect(bridge, SIGNAL(destroyed(QObject*)), this, SLOT(bridgeDestroyed(QObject*)));
+
+        attached[subscription] = bridge;
+    }
+}
+
+void HueHome::detachBridge(HueBridge *bridge)
+{
+    HueEventSubscription *subscription = attached.key(bridge);
+
+    if (subscription == nullptr) {
+        return;
+    }
+
+    attached.remove(subscription);
+    bridge->unsubscribe(subscription);
+    disconnect(bridge, nullptr, this, nullptr);
+
+    removeBridgeResources(bridge);
+    rebuildIndexes();
+
+    emit homeUpdated();
+}
+
+void HueHome::bridgeDestroyed(QObject *bridge)
+{
+    /* the bridge is gone, only our side of the subscription is left */
+    HueEventSubscription *subscription = attached.key(static_cast<HueBridge*>(bridge));
+
+    if (subscription == nullptr) {
+        return;
+    }
+
+    attached.remove(subscription);
+    subscription->deleteLater();
+
+    removeBridgeResources(static_cast<HueBridge*>(bridge));
+    rebuildIndexes();
+
+    emit homeUpdated();
+}
+
+void HueHome::refresh()
+{
+    attachBridges();
+
+    /* per type, a full status would make every bridge widget rebuild */
+    for (HueBridge *bridge : attached.values()) {
+        bridge->getResources(home_types);
+    }
+}
+
+QList<HueHomeResource> HueHome::resources(QString type)
+{
+    QList<HueHomeResource> list;
+
+    for (const HueHomeResource &resource : home_resources) {
+        if (type == "" || resource.type == type) {
+            list.append(resource);
+        }
+    }
+
+    return list;
+}
+
+HueHomeResource HueHome::resource(QString id)
+{
+    return home_resources.value(id);
+}
+
+HueBridge *HueHome::owner(QString id)
+{
+    return home_resources.value(id).bridge;
+}
+
+QStringList HueHome::areas()
+{
+    QStringList names = area_index.uniqueKeys();
+    names.sort(Qt::CaseInsensitive);
+
+    return names;
+}
+
+QList<HueHomeResource> HueHome::area(QString name)
+{
+    QList<HueHomeResource> list;
+
+    for (const QString &id : area_index.values(name)) {
+        list.append(home_resources.value(id));
+    }
+
+    return list;
+}
+
+bool HueHome::areaOn(QString name)
+{
+    for (const HueHomeResource &group : area(name)) {
+        if (group.on) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+double HueHome::areaBrightness(QString name)
+{
+    double sum = 0.0;
+    int count = 0;
+
+    for (const HueHomeResource &group : area(name)) {
+        if (group.on) {
+            sum += group.brightness;
+            count++;
+        }
+    }
+
+    return count > 0 ? sum / count : 0.0;
+}
+
+void HueHome::switchAll(bool on)
+{
+    QByteArray json = hueOnBody(on);
+
+    for (const HueHomeResource &resource : home_resources) {
+        if (resource.type == "bridge_home" && resource.grouped_light != "") {
+            HueTraceScope trace(HueTracer::instance()->begin("home switch all", resource.lights));
+            resource.bridge->commands()->putGroupedLight(resource.grouped_light, json, "on/" + resource.grouped_light);
+        }
+    }
+}
+
+void HueHome::switchArea(QString name, bool on)
+{
+    QByteArray json = hueOnBody(on);
+
+    // every bridge has its own queue, the commands run side by side
+    for (const HueHomeResource &group : area(name)) {
+        if (group.grouped_light != "") {
+            HueTraceScope trace(HueTracer::instance()->begin("home switch " + name, group.lights));
+            group.bridge->commands()->putGroupedLight(group.grouped_light, json, "on/" + group.grouped_light);
+        }
+    }
+}
+
+void HueHome::dimmArea(QString name, double brightness)
+{
+    QByteArray json = hueDimmingBody(brightness);
+
+    for (const HueHomeResource &group : area(name)) {
+        if (group.grouped_light != "") {
+            HueTraceScope trace(HueTracer::instance()->begin("home dimm " + name, group.lights));
+            group.bridge->commands()->putGroupedLight(group.grouped_light, json, "dimming/" + group.grouped_light);
+        }
+    }
+}
+
+void HueHome::switchLight(QString id, bool on)
+{
+    HueBridge *bridge = owner(id);
+
+    if (bridge != nullptr) {
+        HueTraceScope trace(HueTracer::instance()->begin("home switch " + id, QStringList(id)));
+        bridge->commands()->putLight(id, hueOnBody(on), "on/" + id);
+    }
+}
+
+void HueHome::dimmLight(QString id, double brightness)
+{
+    HueBridge *bridge = owner(id);
+
+    if (bridge != nullptr) {
+        HueTraceScope trace(HueTracer::instance()->begin("home dimm " + id, QStringList(id)));
+        bridge->commands()->putLight(id, hueDimmingBody(brightness), "dimming/" + id);
+    }
+}
+
+void HueHome::recallScene(QString id)
+{
+    HueBridge *bridge = owner(id);
+
+    if (bridge == nullptr) {
+        return;
+    }
+
+    HueHomeResource scene = home_resources.value(id);
+    QString group = scene.group != "" ? scene.group : id;
+
+    HueTraceScope trace(HueTracer::instance()->begin("home scene " + id, home_resources.value(group).lights));
+    bridge->commands()->putScene(id, hueRecallBody("active"), "scene/" + group);
+}
+
+void HueHome::removeBridgeResources(HueBridge *bridge)
+{
+    QMutableHashIterator<QString, HueHomeResource> resource(home_resources);
+    while (resource.hasNext()) {
+        if (resource.next().value().bridge == bridge) {
+            resource.remove();
+        }
+    }
+}
+
+void HueHome::readStatus(QJsonObject json)
+{
+    HueBridge *bridge = qobject_cast<HueBridge*>(sender());
+
+    if (bridge == nullptr || !json.contains("data")) {
+        return;
+    }
+
+    readBridge(bridge);
+}
+
+void HueHome::readResource(QString type, QJsonObject json)
+{
+    HueBridge *bridge = qobject_cast<HueBridge*>(sender());
+
+    /* single resources ("light/<id>") are left to the events */
+    if (bridge == nullptr || !home_types.contains(type) || !json.contains("data")) {
+        return;
+    }
+
+    readBridge(bridge);
+}
+
+void HueHome::readBridge(HueBridge *bridge)
+{
+    removeBridgeResources(bridge);
+
+    /* the bridge has stored the reply before telling us about it */
+    std::shared_ptr<const HueSnapshot> snapshot = bridge->snapshot();
+
+    QList<QJsonObject> json_items;
+    for (const QString &type : home_types) {
+        json_items.append(snapshot->resourcesOfType(type));
+    }
+
+    QHash<QString, QStringList> device_lights;
+    QHash<QString, QJsonObject> grouped_lights;
+    QStringList bridge_lights;
+    QStringList groups;
+
+    for (const QJsonObject &json_item : json_items) {
+        QString type = json_item["type"].toString();
+        QString id = json_item["id"].toString();
+
+        if (type == "device") {
+            QJsonArray services = json_item["services"].toArray();
+
+            for (int j = 0; j < services.size(); ++j) {
+                if (services[j].toObject()["rtype"].toString() == "light") {
+                    device_lights[id].append(services[j].toObject()["rid"].toString());
+                }
+            }
+
+            continue;
+        }
+
+        if (type == "grouped_light") {
+            grouped_lights[id] = json_item;
+            continue;
+        }
+
+        if (type != "light" && type != "room" && type != "zone" && type != "bridge_home" && type != "scene") {
+            continue;
+        }
+
+        HueHomeResource resource;
+        resource.id = id;
+        resource.type = type;
+        resource.bridge = bridge;
+        resource.name = json_item["metadata"].toObject()["name"].toString();
+        resource.archetype = json_item["metadata"].toObject()["archetype"].toString();
+
+        if (type == "light") {
+            resource.on = json_item["on"].toObject()["on"].toBool();
+            resource.brightness = json_item["dimming"].toObject()["brightness"].toDouble();
+            bridge_lights.append(id);
+        }
+
+        if (type == "scene") {
+            resource.group = json_item["group"].toObject()["rid"].toString();
+        }
+
+        if (type == "bridge_home") {
+            resource.name = bridge->deviceName();
+        }
+
+        QJsonArray services = json_item["services"].toArray();
+        for (int j = 0; j < services.size(); ++j) {
+            if (services[j].toObject()["rtype"].toString() == "grouped_light") {
+                resource.grouped_light = services[j].toObject()["rid"].toString();
+            }
+        }
+
+        if (type == "room" || type == "zone" || type == "bridge_home") {
+            groups.append(id);
+            resource.lights = QStringList();
+
+            // children are resolved once all devices are known
+            QJsonArray children = json_item["children"].toArray();
+            for (int j = 0; j < children.size(); ++j) {
+                QJsonObject child = children[j].toObject();
+                resource.lights.append(child["rtype"].toString() + "/" + child["rid"].toString());
+            }
+        }
+
+        home_resources[id] = resource;
+    }
+
+    for (const QString &id : groups) {
+        HueHomeResource &group = home_resources[id];
+        QStringList children = group.lights;
+        group.lights.clear();
+
+        if (group.type == "bridge_home") {
+            group.lights = bridge_lights;
+        } else {
+            for (const QString &child : children) {
+                QString rtype = child.section('/', 0, 0);
+                QString rid = child.section('/', 1);
+
+                if (rtype == "light") {
+                    group.lights.append(rid);
+                } else if (rtype == "device") {
+                    group.lights.append(device_lights.value(rid));
+                }
+            }
+        }
+
+        if (grouped_lights.contains(group.grouped_light)) {
+            QJsonObject grouped_light = grouped_lights[group.grouped_light];
+            group.on = grouped_light["on"].toObject()["on"].toBool();
+            group.brightness = grouped_light["dimming"].toObject()["brightness"].toDouble();
+        }
+    }
+
+    rebuildIndexes();
+
+    emit homeUpdated();
+}
+
+void HueHome::rebuildIndexes()
+{
+    area_index.clear();
+    grouped_light_index.clear();
+
+    for (const HueHomeResource &resource : home_resources) {
+        if (resource.grouped_light != "") {
+            grouped_light_index[resource.grouped_light] = resource.id;
+        }
+
+        if (resource.type == "room" || resource.type == "zone") {
+            area_index.insert(resource.name, resource.id);
+        }
+    }
+}
+
+void HueHome::readEvent(const HueEvent &event)
+{
+    QString id = event.id;
+
+    if (event.type == "grouped_light") {
+        id = grouped_light_index.value(event.id);
+    }
+
+    if (event.event != event_update || !home_resources.contains(id)) {
+        return;
+    }
+
+    HueHomeResource &resource = home_resources[id];
+
+    if (event.has_on) {
+        resource.on = event.on;
+    }
+
+    if (event.has_brightness) {
+        resource.brightness = event.brightness;
+    }
+
+    emit resourceChanged(id);
+}
@@ -0,0 +1,248 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QtNumeric>
+
+#include "huejson.h"
+
+HueJsonWriter::HueJsonWriter(int reserve)
+{
+    reserve_size = reserve;
+    buffer.reserve(reserve_size);
+}
+
+void HueJsonWriter::writeKey(const char *key)
+{
+    if (!first) {
+        buffer.append(',');
+    }
+
+    first = false;
+
+    if (key == nullptr) {
+        return;
+    }
+
+    buffer.append('"');
+    buffer.append(key);
+    buffer.append("\":");
+}
+
+void HueJsonWriter::writeString(const QString &value)
+{
+    static const char hex[] = "0123456789abcdef";
+    QByteArray utf8 = value.toUtf8();
+
+    buffer.append('"');
+
+    for (char c : utf8) {
+        switch (c) {
+            case '"': buffer.append("\\\""); break;
+            case '\\': buffer.append("\\\\"); break;
+            case '\n': buffer.append("\\n"); break;
+            case '\r': buffer.append("\\r"); break;
+            case '\t': buffer.append("\\t"); break;
+            default:
+                if ((unsigned char) c < 0x20) {
+                    buffer.append("\\u00");
+                    buffer.append(hex[(c >> 4) & 0x0f]);
+                    buffer.append(hex[c & 0x0f]);
+                } else {
+                    buffer.append(c);
+                }
+        }
+    }
+
+    buffer.append('"');
+}
+
+HueJsonWriter &HueJsonWriter::beginObject(const char *key)
+{
+    writeKey(key);
+    buffer.append('{');
+    first = true;
+
+    return *this;
+}
+
+HueJsonWriter &HueJsonWriter::endObject()
+{
+    buffer.append('}');
+    first = false;
+
+    return *this;
+}
+
+HueJsonWriter &HueJsonWriter::beginArray(const char *key)
+{
+    writeKey(key);
+    buffer.append('[');
+    first = true;
+
+    return *this;
+}
+
+HueJsonWriter &HueJsonWriter::endArray()
+{
+    buffer.append(']');
+    first = false;
+
+    return *this;
+}
+
+HueJsonWriter &HueJsonWriter::value(const char *key, bool value)
+{
+    writeKey(key);
+    buffer.append(value ? "true" : "false");
+
+    return *this;
+}
+
+HueJsonWriter &HueJsonWriter::value(const char *key, int value)
+{
+    writeKey(key);
+    buffer.append(QByteArray::number(value));
+
+    return *this;
+}
+
+HueJsonWriter &HueJsonWriter::value(const char *key, double value)
+{
+    writeKey(key);
+
+    /* JSON has no nan or infinity, write null like QJsonDocument does */
+    if (!qIsFinite(value)) {
+        buffer.append("null");
+    } else {
+        buffer.append(QByteArray::number(value, 'g', 8));
+    }
+
+    return *this;
+}
+
+HueJsonWriter &HueJsonWriter::value(const char *key, const char *value)
+{
+    writeKey(key);
+    writeString(QString::fromUtf8(value));
+
+    return *this;
+}
+
+HueJsonWriter &HueJsonWriter::value(const char *key, const QString &value)
+{
+    writeKey(key);
+    writeString(value);
+
+    return *this;
+}
+
+HueJsonWriter &HueJsonWriter::value(const char *key, const QJsonValue &value)
+{
+    switch (value.type()) {
+        case QJsonValue::Bool:
+            return this->value(key, value.toBool());
+        case QJsonValue::Double:
+            return this->value(key, value.toDouble());
+        case QJsonValue::String:
+            return this->value(key, value.toString());
+        case QJsonValue::Object:
+            writeKey(key);
+            buffer.append(QJsonDocument(value.toObject()).toJson(QJsonDocument::Compact));
+            return *this;
+        case QJsonValue::Array:
+            writeKey(key);
+            buffer.append(QJsonDocument(value.toArray()).toJson(QJsonDocument::Compact));
+            return *this;
+        default:
+            writeKey(key);
+            buffer.append("null");
+            return *this;
+    }
+}
+
+QByteArray HueJsonWriter::take()
+{
+    QByteArray data = buffer;
+
+    /* the next body starts in a fresh buffer, the taken one goes with the request */
+    buffer = QByteArray();
+    buffer.reserve(reserve_size);
+    first = true;
+
+    return data;
+}
+
+QByteArray hueOnBody(bool on)
+{
+    HueJsonWriter writer(32);
+
+    writer.beginObject()
+        .beginObject("on").value("on", on).endObject()
+    .endObject();
+
+    return writer.take();
+}
+
+QByteArray hueDimmingBody(double brightness)
+{
+    HueJsonWriter writer(64);
+
+    writer.beginObject()
+        .beginObject("on").value("on", true).endObject()
+        .beginObject("dimming").value("brightness", brightness).endObject()
+    .endObject();
+
+    return writer.take();
+}
+
+QByteArray hueColorBody(double x, double y)
+{
+    HueJsonWriter writer(80);
+
+    writer.beginObject()
+        .beginObject("on").value("on", true).endObject()
+        .beginObject("color").beginObject("xy").value("x", x).value("y", y).endObject().endObject()
+    .endObject();
+
+    return writer.take();
+}
+
+QByteArray hueMirekBody(int mirek)
+{
+    HueJsonWriter writer(64);
+
+    writer.beginObject()
+        .beginObject("on").value("on", true).endObject()
+        .beginObject("color_temperature").value("mirek", mirek).endObject()
+    .endObject();
+
+    return writer.take();
+}
+
+QByteArray hueRecallBody(const char *action)
+{
+    HueJsonWriter writer(48);
+
+    writer.beginObject()
+        .beginObject("recall").value("action", action).endObject()
+    .endObject();
+
+    return writer.take();
+}
@@ -38,3 +38,92 @@ QString HueList::getStoragePath(QString name)
         return name;
     #endif
 }
+
+HueDevice* HueList::findDevice(QString s)
+{
+    if (s == "") {
+        return NULL;
+    }
+
+    if (index_id.contains(s)) {
+        return index_id[s];
+    }
+
+    if (index_ip.contains(s)) {
+        return index_ip[s];
+    }
+
+    if (index_mdns_name.contains(s)) {
+        return index_mdns_name[s];
+    }
+
+    return NULL;
+}
+
+void HueList::indexDevice(HueDevice *device)
+{
+    indexed_devices.append(device);
+
+    reindex(index_id, &HueDevice::id, device, "", device->id());
+    reindex(index_ip, &HueDevice::ip, device, "", device->ip());
+    reindex(index_mdns_name, &HueDevice::mdnsName, device, "", device->mdnsName());
+
+    connect(device, SIGNAL(idChanged(QString)), this, SLOT(deviceIdChanged(QString)));
+    connect(device, SIGNAL(ipChanged(QString)), this, SLOT(deviceIpChanged(QString)));
+    connect(device, SIGNAL(mdnsNameChanged(QString)), this, SLOT(deviceMdnsNameChanged(QString)));
+}
+
+void HueList::unindexDevice(HueDevice *device)
+{
+    disconnect(device, SIGNAL(idChanged(QString)), this, SLOT(deviceIdChanged(QString)));
+    disconnect(device, SIGNAL(ipChanged(QString)), this, SLOT(deviceIpChanged(QString)));
+    disconnect(device, SIGNAL(mdnsNameChanged(QString)), this, SLOT(deviceMdnsNameChanged(QString)));
+
+    indexed_devices.removeAll(device);
+
+    reindex(index_id, &HueDevice::id, device, device->id(), "");
+    reindex(index_ip, &HueDevice::ip, device, device->ip(), "");
+    reindex(index_mdns_name, &HueDevice::mdnsName, device, device->mdnsName(), "");
+}
+
+void HueList::reindex(QHash<QString, HueDevice*> &index, QString (HueDevice::*key)(), HueDevice *device, QString previous, QString current)
+{
+    /* a released key goes to the next device which still has it */
+    if (previous != "" && index.value(previous) == device) {
+        index.remove(previous);
+
+        for (HueDevice *other : indexed_devices) {
+            if (other != device && (other->*key)() == previous) {
+                index[previous] = other;
+                break;
+            }
+        }
+    }
+
+    /* another device earlier in the list keeps its key */
+    if (current != "") {
+        HueDevice *owner = index.value(current);
+
+        if (owner == nullptr || indexed_devices.indexOf(device) < indexed_devices.indexOf(owner)) {
+            index[current] = device;
+        }
+    }
+}
+
+void HueList::deviceIdChanged(QString previous)
+{
+    HueDevice *device = qobject_cast<HueDevice *>(sender());
+    reindex(index_id, &HueDevice::id, device, previous, device->id());
+}
+
+void HueList::deviceIpChanged(QString previous)
+{
+    HueDevice *device = qobject_cast<HueDevice *>(sender());
+    reindex(index_ip, &HueDevice::ip, device, previous, device->ip());
+}
+
+void HueList::deviceMdnsNameChanged(QString previous)
+{
+    HueDevice *device = qobject_cast<HueDevice *>(sender());
+    reindex(index_mdns_name, &HueDevice::mdnsName, device, previous, device->mdnsName());
+}
@@ -0,0 +1,235 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QtEndian>
+#include <QStringList>
+#include <QtNetwork/QNetworkDatagram>
+
+#include "huemdns.h"
+
+enum HueMdnsRecordTypes {
+    mdns_type_a = 1,
+    mdns_type_ptr = 12,
+    mdns_type_txt = 16,
+    mdns_type_srv = 33
+};
+
+/* labels before the first compression pointer must lie before end */
+static QString readName(const QByteArray &data, int &offset, int end = -1)
+{
+    QStringList labels;
+    int pos = offset;
+    int jumps = 0;
+    bool jumped = false;
+    int limit = end < 0 ? data.size() : qMin(end, int(data.size()));
+
+    while (pos < limit) {
+        quint8 length = data[pos];
+
+        /* compression pointer */
+        if ((length & 0xC0) == 0xC0) {
+            if (pos + 1 >= limit || ++jumps > 16) {
+                break;
+            }
+
+            if (!jumped) {
+                offset = pos + 2;
+            }
+
+            pos = ((length & 0x3F) << 8) | (quint8) data[pos + 1];
+            jumped = true;
+            limit = data.size();
+            continue;
+        }
+
+        if (length == 0) {
+            if (!jumped) {
+                offset = pos + 1;
+            }
+
+            return labels.join(".");
+        }
+
+        if (pos + 1 + length > limit) {
+            break;
+        }
+
+        labels.append(QString::fromUtf8(data.mid(pos + 1, length)));
+        pos += 1 + length;
+    }
+
+    offset = data.size();
+    return "";
+}
+
+static QJsonObject readTxt(const QByteArray &data, int offset, int length)
+{
+    QJsonObject txt;
+    int end = offset + length;
+
+    while (offset < end) {
+        quint8 item_length = data[offset];
+        QString item = QString::fromUtf8(data.mid(offset + 1, item_length));
+        offset += 1 + item_length;
+
+        int separator = item.indexOf('=');
+        if (separator > 0) {
+            txt[item.left(separator).toLower()] = item.mid(separator + 1);
+        }
+    }
+
+    return txt;
+}
+
+HueMdnsBrowser::HueMdnsBrowser(QObject *parent): QObject(parent)
+{
+    socket = new QUdpSocket(this);
+
+    if (!socket->bind(QHostAddress::AnyIPv4, 0)) {
+        qWarning() << "mdns - unable to bind socket: " + socket->errorString();
+    }
+
+    connect(socket, SIGNAL(readyRead()), this, SLOT(readDatagrams()));
+}
+
+void HueMdnsBrowser::browse(QString service)
+{
+    browsed_service = service;
+    resolved.clear();
+
+    socket->writeDatagram(createQuery(browsed_service), mdns_address, mdns_port);
+}
+
+QByteArray HueMdnsBrowser::createQuery(QString service)
+{
+    QByteArray query;
+
+    /* header: id, flags, 1 question, no answers */
+    query.append("\x00\x00\x00\x00\x00\x01\x00\x00\x00\x00\x00\x00", 12);
+
+    foreach (const QString &label, service.split('.')) {
+        QByteArray bytes = label.toUtf8();
+        query.append((char) bytes.size());
+        query.append(bytes);
+    }
+    query.append((char) 0);
+
+    /* PTR, class IN with the unicast-response bit */
+    query.append("\x00\x0c\x80\x01", 4);
+
+    return query;
+}
+
+void HueMdnsBrowser::readDatagrams()
+{
+    while (socket->hasPendingDatagrams()) {
+        QNetworkDatagram datagram = socket->receiveDatagram();
+        QHostAddress sender(datagram.senderAddress().toIPv4Address());
+
+        readResponse(datagram.data(), sender.toString());
+    }
+}
+
+void HueMdnsBrowser::readResponse(const QByteArray &data, QString sender)
+{
+    if (data.size() < 12) {
+        return;
+    }
+
+    const uchar *raw = (const uchar *) data.constData();
+    int questions = qFromBigEndian<quint16>(raw + 4);
+    int records = qFromBigEndian<quint16>(raw + 6) + qFromBigEndian<quint16>(raw + 8) + qFromBigEndian<quint16>(raw + 10);
+    int offset = 12;
+
+    for (int i = 0; i < questions && offset < data.size(); ++i) {
+        readName(data, offset);
+        offset += 4;
+    }
+
+    for (int i = 0; i < records && offset + 10 <= data.size(); ++i) {
+        QString name = readName(data, offset);
+        if (offset + 10 > data.size()) {
+            break;
+        }
+
+        quint16 type = qFromBigEndian<quint16>(raw + offset);
+        quint16 length = qFromBigEndian<quint16>(raw + offset + 8);
+        int rdata = offset + 10;
+        offset = rdata + length;
+
+        if (offset > data.size()) {
+            break;
+        }
+
+        switch (type) {
+            case mdns_type_ptr:
+                {
+                    int ptr_offset = rdata;
+                    if (name.compare(browsed_service, Qt::CaseInsensitive) == 0) {
+                        instances.insert(readName(data, ptr_offset, rdata + length));
+                    }
+                    break;
+                }
+
+            case mdns_type_srv:
+                {
+                    /* priority, weight and port come before the target */
+                    if (length < 6) {
+                        break;
+                    }
+
+                    int target_offset = rdata + 6;
+                    srv_ports[name] = qFromBigEndian<quint16>(raw + rdata + 4);
+                    srv_targets[name] = readName(data, target_offset, rdata + length);
+                    break;
+                }
+
+            case mdns_type_txt:
+                {
+                    txt_records[name] = readTxt(data, rdata, length);
+                    break;
+                }
+
+            case mdns_type_a:
+                {
+                    if (length == 4) {
+                        addresses[name] = QHostAddress(qFromBigEndian<quint32>(raw + rdata)).toString();
+                    }
+                    break;
+                }
+
+            default:
+                {
+                    break;
+                }
+        }
+    }
+
+    foreach (const QString &instance, instances) {
+        if (resolved.contains(instance) || !srv_targets.contains(instance)) {
+            continue;
+        }
+
+        /* without an A record the responder itself is the best guess */
+        QString ip = addresses.value(srv_targets[instance], sender);
+        QString name = instance.left(instance.length() - browsed_service.length() - 1);
+
+        resolved.insert(instance);
+        emit serviceResolved(name, ip, srv_ports[instance], txt_records.value(instance));
+    }
+}
@@ -0,0 +1,264 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QtNetwork/QLocalSocket>
+
+#include "huemetrics.h"
+
+static const qint64 hueLatencyBounds[HUEMETRICS_BUCKETS - 1] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000};
+
+HueMetrics::HueMetrics(QObject *parent): QObject(parent)
+{
+    clock.start();
+}
+
+HueMetrics *HueMetrics::instance()
+{
+    static HueMetrics metrics;
+    return &metrics;
+}
+
+qint64 HueMetrics::now()
+{
+    return clock.elapsed();
+}
+
+QString HueMetrics::endpoint(QNetworkAccessManager::Operation operation, const QUrl &url)
+{
+    QString method;
+
+    switch (operation) {
+        case QNetworkAccessManager::GetOperation:
+            method = "GET";
+            break;
+        case QNetworkAccessManager::PutOperation:
+            method = "PUT";
+            break;
+        case QNetworkAccessManager::PostOperation:
+            method = "POST";
+            break;
+        case QNetworkAccessManager::DeleteOperation:
+            method = "DELETE";
+            break;
+        default:
+            method = "OTHER";
+            break;
+    }
+
+    /* resource ids and user names would give every light its own endpoint */
+    QStringList segments = url.path().split('/');
+    for (QString &segment : segments) {
+        if (segment.size() >= 20) {
+            segment = "{id}";
+        }
+    }
+
+    return method + " " + segments.join('/');
+}
+
+void HueMetrics::addSample(HueLatencyHistogram &histogram, qint64 value_ms, bool ok)
+{
+    int bucket = 0;
+    while (bucket < HUEMETRICS_BUCKETS - 1 && value_ms > hueLatencyBounds[bucket]) {
+        bucket++;
+    }
+
+    histogram.counts[bucket]++;
+    histogram.total++;
+    histogram.sum_ms += value_ms;
+    histogram.max_ms = qMax(histogram.max_ms, value_ms);
+
+    if (!ok) {
+        histogram.errors++;
+    }
+}
+
+void HueMetrics::requestStarted()
+{
+    QMutexLocker locker(&mutex);
+
+    in_flight++;
+    in_flight_max = qMax(in_flight_max, in_flight);
+}
+
+void HueMetrics::requestFinished(const QString &endpoint, qint64 elapsed_ms, bool ok)
+{
+    QMutexLocker locker(&mutex);
+
+    in_flight = qMax(0, in_flight - 1);
+    addSample(latencies[endpoint], elapsed_ms, ok);
+}
+
+void HueMetrics::setQueueDepth(const QString &queue, int depth)
+{
+    QMutexLocker locker(&mutex);
+
+    queue_depths[queue] = depth;
+    queue_depths_max[queue] = qMax(queue_depths_max.value(queue), depth);
+}
+
+void HueMetrics::addCoalesced(const QString &queue, int count)
+{
+    QMutexLocker locker(&mutex);
+
+    coalesced[queue] += count;
+}
+
+void HueMetrics::addEventLag(qint64 lag_ms)
+{
+    QMutexLocker locker(&mutex);
+
+    // bridge and host clocks are not synchronized, a negative lag is noise
+    addSample(event_lag, qMax(Q_INT64_C(0), lag_ms), true);
+}
+
+void HueMetrics::addReconnect(const QString &source)
+{
+    QMutexLocker locker(&mutex);
+
+    reconnects[source]++;
+}
+
+QJsonObject HueMetrics::histogramJson(const HueLatencyHistogram &histogram)
+{
+    QJsonObject json;
+    QJsonArray json_buckets;
+
+    for (int i = 0; i < HUEMETRICS_BUCKETS; ++i) {
+        QJsonObject json_bucket;
+        if (i < HUEMETRICS_BUCKETS - 1) {
+            json_bucket["le_ms"] = hueLatencyBounds[i];
+        } else {
+            json_bucket["le_ms"] = "inf";
+        }
+        json_bucket["count"] = (qint64) histogram.counts[i];
+        json_buckets.append(json_bucket);
+    }
+
+    json["count"] = (qint64) histogram.total;
+    json["errors"] = (qint64) histogram.errors;
+    json["max_ms"] = histogram.max_ms;
+    json["mean_ms"] = histogram.total > 0 ? (double) histogram.sum_ms / histogram.total : 0.0;
+    json["buckets"] = json_buckets;
+
+    return json;
+}
+
+QJsonObject HueMetrics::dump()
+{
+    QMutexLocker locker(&mutex);
+
+    QJsonObject json;
+
+    QJsonObject json_requests;
+    json_requests["in_flight"] = in_flight;
+    json_requests["in_flight_max"] = in_flight_max;
+
+    QJsonObject json_endpoints;
+    for (auto i = latencies.constBegin(); i != latencies.constEnd(); ++i) {
+        json_endpoints[i.key()] = histogramJson(i.value());
+    }
+    json_requests["endpoints"] = json_endpoints;
+    json["requests"] = json_requests;
+
+    QJsonObject json_queues;
+    for (auto i = queue_depths.constBegin(); i != queue_depths.constEnd(); ++i) {
+        QJsonObject json_queue;
+        json_queue["depth"] = i.value();
+        json_queue["depth_max"] = queue_depths_max.value(i.key());
+        json_queue["coalesced"] = (qint64) coalesced.value(i.key());
+        json_queues[i.key()] = json_queue;
+    }
+    json["queues"] = json_queues;
+
+    json["event_lag"] = histogramJson(event_lag);
+
+    QJsonObject json_reconnects;
+    for (auto i = reconnects.constBegin(); i != reconnects.constEnd(); ++i) {
+        json_reconnects[i.key()] = (qint64) i.value();
+    }
+    json["reconnects"] = json_reconnects;
+
+    json["uptime_ms"] = clock.elapsed();
+
+    return json;
+}
+
+QByteArray HueMetrics::dumpJson()
+{
+    QJsonDocument doc(dump());
+    return doc.toJson(QJsonDocument::Indented);
+}
+
+bool HueMetrics::listen(const QString &name)
+{
+    stopListening();
+
+    server = new QLocalServer(this);
+    connect(server, SIGNAL(newConnection()), this, SLOT(clientConnected()));
+
+    /* the instance outlives the application, the server must not */
+    if (QCoreApplication::instance() != nullptr) {
+        connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(stopListening()), Qt::UniqueConnection);
+    }
+
+    if (!server->listen(name) && server->serverError() == QAbstractSocket::AddressInUseError) {
+        /* a crashed run leaves its socket behind, a running one answers */
+        QLocalSocket probe;
+        probe.connectToServer(name);
+
+        if (!probe.waitForConnected(probe_timeout)) {
+            QLocalServer::removeServer(name);
+            server->listen(name);
+        }
+    }
+
+    if (!server->isListening()) {
+        qWarning() << "metrics socket: " + server->errorString();
+        stopListening();
+        return false;
+    }
+
+    return true;
+}
+
+void HueMetrics::stopListening()
+{
+    if (server == nullptr) {
+        return;
+    }
+
+    server->close();
+    delete server;
+    server = nullptr;
+}
+
+void HueMetrics::clientConnected()
+{
+    while (server->hasPendingConnections()) {
+        QLocalSocket *socket = server->nextPendingConnection();
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+
+        socket->write(dumpJson());
+        socket->disconnectFromServer();
+    }
+}
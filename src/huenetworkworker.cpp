@@ -0,0 +1,112 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+
+#include "huedevice.h"
+#include "hueevent.h"
+#include "huenetworkworker.h"
+
+HueNetworkWorker::HueNetworkWorker(bool compact_events): QObject(nullptr)
+{
+    qRegisterMetaType<HueWorkerRequest>("HueWorkerRequest");
+    qRegisterMetaType<HueWorkerReply>("HueWorkerReply");
+
+    compact = compact_events;
+
+    moveToThread(networkThread());
+}
+
+QThread *HueNetworkWorker::networkThread()
+{
+    static QThread *thread = nullptr;
+
+    if (thread == nullptr) {
+        thread = new QThread();
+        thread->setObjectName("hue-network");
+
+        /* the thread must be gone before the statics are destroyed */
+        QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, [] {
+            thread->quit();
+            thread->wait();
+        });
+
+        thread->start();
+    }
+
+    return thread;
+}
+
+void HueNetworkWorker::send(HueWorkerRequest request)
+{
+    // created here to belong to the network thread
+    if (manager == nullptr) {
+        manager = new QNetworkAccessManager(this);
+
+        connect(manager, SIGNAL(sslErrors(QNetworkReply*, QList<QSslError>)), this, SLOT(sslErrors(QNetworkReply*, QList<QSslError>)));
+        connect(manager, SIGNAL(finished(QNetworkReply*)), this, SLOT(replyFinished(QNetworkReply*)));
+    }
+
+    switch (request.operation) {
+        case QNetworkAccessManager::PutOperation:
+            manager->put(request.request, request.data);
+            break;
+        case QNetworkAccessManager::PostOperation:
+            manager->post(request.request, request.data);
+            break;
+        case QNetworkAccessManager::DeleteOperation:
+            manager->deleteResource(request.request);
+            break;
+        default:
+            manager->get(request.request);
+            break;
+    }
+}
+
+void HueNetworkWorker::sslErrors(QNetworkReply *reply, QList<QSslError> errors)
+{
+    (void) errors;
+
+    if (reply->request().attribute(HUEREQUEST_IGNORE_SSL).toBool()) {
+        reply->ignoreSslErrors();
+    }
+}
+
+void HueNetworkWorker::replyFinished(QNetworkReply *reply)
+{
+    HueWorkerReply finished_reply;
+    finished_reply.request = reply->request();
+    finished_reply.operation = reply->operation();
+    finished_reply.ok = reply->error() == QNetworkReply::NoError;
+
+    if (finished_reply.ok) {
+        QByteArray body = reply->readAll();
+
+        finished_reply.body = QString::fromUtf8(body);
+        finished_reply.json = QJsonDocument::fromJson(body);
+
+        if (compact && finished_reply.json.isArray()) {
+            finished_reply.json = QJsonDocument(hueCompactEvents(finished_reply.json.array()));
+        }
+    } else {
+        finished_reply.error = reply->errorString();
+    }
+
+    reply->deleteLater();
+
+    emit finished(finished_reply);
+}
@@ -0,0 +1,498 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QtMath>
+#include <QRegularExpression>
+#include <QPair>
+#include <algorithm>
+
+#include "huebridge.h"
+#include "huescheduler.h"
+
+static bool parseCronField(const QString &field, int min, int max, quint64 &bits)
+{
+    bits = 0;
+
+    for (const QString &item : field.split(',')) {
+        QString range = item;
+        int step = 1;
+        int first;
+        int last;
+        bool ok = true;
+        bool ok_last = true;
+
+        int slash = item.indexOf('/');
+        if (slash >= 0) {
+            step = item.mid(slash + 1).toInt(&ok);
+            if (!ok || step <= 0) {
+                return false;
+            }
+            range = item.left(slash);
+        }
+
+        if (range == "*") {
+            first = min;
+            last = max;
+        } else {
+            int dash = range.indexOf('-');
+            if (dash >= 0) {
+                first = range.left(dash).toInt(&ok);
+                last = range.mid(dash + 1).toInt(&ok_last);
+            } else {
+                first = range.toInt(&ok);
+                /* "5/15" runs from 5 to the end of the range */
+                last = slash >= 0 ? max : first;
+            }
+        }
+
+        if (!ok || !ok_last || first < min || last > max || first > last) {
+            return false;
+        }
+
+        for (int value = first; value <= last; value += step) {
+            bits |= Q_UINT64_C(1) << value;
+        }
+    }
+
+    return true;
+}
+
+HueCron hueParseCron(const QString &expression)
+{
+    HueCron cron;
+    quint64 bits;
+
+    QStringList fields = expression.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+    if (fields.size() != 5) {
+        return cron;
+    }
+
+    if (!parseCronField(fields[0], 0, 59, bits)) {return cron;}
+    cron.minutes = bits;
+
+    if (!parseCronField(fields[1], 0, 23, bits)) {return cron;}
+    cron.hours = bits;
+
+    if (!parseCronField(fields[2], 1, 31, bits)) {return cron;}
+    cron.days = bits;
+
+    if (!parseCronField(fields[3], 1, 12, bits)) {return cron;}
+    cron.months = bits;
+
+    if (!parseCronField(fields[4], 0, 7, bits)) {return cron;}
+    cron.weekdays = (bits | (bits >> 7)) & 0x7f;
+
+    // as in cron, a field starting with * (like */2) counts as unrestricted
+    cron.any_day = fields[2].startsWith('*');
+    cron.any_weekday = fields[4].startsWith('*');
+    cron.valid = true;
+
+    return cron;
+}
+
+QDateTime hueCronNext(const HueCron &cron, const QDateTime &after)
+{
+    if (!cron.valid) {
+        return QDateTime();
+    }
+
+    QDateTime local = after.toLocalTime();
+    QDateTime start = QDateTime(local.date(), QTime(local.time().hour(), local.time().minute())).addSecs(60);
+    int start_minute = start.time().hour() * 60 + start.time().minute();
+
+    for (int d = 0; d <= 4 * 366; ++d) {
+        QDate day = start.date().addDays(d);
+
+        if (!((cron.months >> day.month()) & 1)) {
+            continue;
+        }
+
+        bool day_match = (cron.days >> day.day()) & 1;
+        bool weekday_match = (cron.weekdays >> (day.dayOfWeek() % 7)) & 1;
+
+        /* like cron, a restricted day and weekday match when either does */
+        if (!cron.any_day && !cron.any_weekday) {
+            if (!day_match && !weekday_match) {
+                continue;
+            }
+        } else if (!day_match || !weekday_match) {
+            continue;
+        }
+
+        int from = d == 0 ? start_minute : 0;
+
+        for (int hour = from / 60; hour < 24; ++hour) {
+            if (!((cron.hours >> hour) & 1)) {
+                continue;
+            }
+
+            for (int minute = hour == from / 60 ? from % 60 : 0; minute < 60; ++minute) {
+                if (!((cron.minutes >> minute) & 1)) {
+                    continue;
+                }
+
+                /* local times skipped by a daylight saving change are moved forward by Qt */
+                QDateTime result(day, QTime(hour, minute));
+                if (result > after) {
+                    return result;
+                }
+            }
+        }
+    }
+
+    return QDateTime();
+}
+
+QDateTime hueSunEvent(QDate date, double latitude, double longitude, bool sunrise)
+{
+    /* the sunrise equation, good to about a minute */
+    double mean_noon = date.toJulianDay() - 2451545.0 + 0.0008 - longitude / 360.0;
+    double anomaly = std::fmod(357.5291 + 0.98560028 * mean_noon, 360.0);
+    double anomaly_rad = qDegreesToRadians(anomaly);
+    double center = 1.9148 * qSin(anomaly_rad) + 0.0200 * qSin(2.0 * anomaly_rad) + 0.0003 * qSin(3.0 * anomaly_rad);
+    double ecliptic_rad = qDegreesToRadians(std::fmod(anomaly + center + 180.0 + 102.9372, 360.0));
+    double transit = 2451545.0 + mean_noon + 0.0053 * qSin(anomaly_rad) - 0.0069 * qSin(2.0 * ecliptic_rad);
+
+    double declination = qAsin(qSin(ecliptic_rad) * qSin(qDegreesToRadians(23.4397)));
+    double latitude_rad = qDegreesToRadians(latitude);
+    double cos_hour_angle = (qSin(qDegreesToRadians(-0.833)) - qSin(latitude_rad) * qSin(declination)) / (qCos(latitude_rad) * qCos(declination));
+
+    if (cos_hour_angle < -1.0 || cos_hour_angle > 1.0) {
+        return QDateTime();
+    }
+
+    double hour_angle = qRadiansToDegrees(qAcos(cos_hour_angle));
+    double julian = transit + (sunrise ? -hour_angle : hour_angle) / 360.0;
+
+    return QDateTime::fromMSecsSinceEpoch(qint64((julian - 2440587.5) * 86400000.0)).toUTC();
+}
+
+QDateTime HueClock::now() const
+{
+    return QDateTime::currentDateTimeUtc();
+}
+
+HueBridgeCommandSink::HueBridgeCommandSink(HueBridge *hue_bridge)
+{
+    bridge = hue_bridge;
+}
+
+void HueBridgeCommandSink::recallScenes(QStringList scene_ids)
+{
+    bridge->recallScenes(scene_ids);
+}
+
+void HueBridgeCommandSink::switchGroups(QStringList grouped_light_ids, bool on)
+{
+    bridge->switchGroups(grouped_light_ids, on);
+}
+
+HueScheduler::HueScheduler(HueCommandSink *command_sink, HueClock *scheduler_clock, QObject *parent): QObject(parent)
+{
+    sink = command_sink;
+    clock = scheduler_clock;
+
+    if (clock == nullptr) {
+        clock = new HueClock();
+        own_clock = true;
+    }
+
+    wheel.resize(wheel_slots);
+    current_tick = clock->now().toMSecsSinceEpoch() / tick_msec;
+
+    tick_timer = new QTimer(this);
+    connect(tick_timer, SIGNAL(timeout()), this, SLOT(advance()));
+}
+
+HueScheduler::~HueScheduler()
+{
+    if (own_clock) {
+        delete clock;
+    }
+}
+
+void HueScheduler::setLocation(double latitude, double longitude)
+{
+    has_location = true;
+    location_latitude = latitude;
+    location_longitude = longitude;
+
+    rescheduleAll();
+}
+
+void HueScheduler::start()
+{
+    tick_timer->start(tick_msec);
+}
+
+void HueScheduler::stop()
+{
+    tick_timer->stop();
+}
+
+bool HueScheduler::addRule(HueScheduleRule rule)
+{
+    RuleState state;
+    QDateTime now = clock->now();
+
+    if (rule.id == "") {
+        return false;
+    }
+
+    state.rule = rule;
+
+    if (rule.trigger == schedule_cron) {
+        state.cron = hueParseCron(rule.cron);
+
+        if (!state.cron.valid) {
+            return false;
+        }
+    }
+
+    /* runs missed since the stored last run are found like a stalled tick */
+    QDateTime after = now;
+    if (rule.catch_up && rule.last_run.isValid() && rule.last_run < now) {
+        after = rule.last_run;
+    }
+
+    RuleState &stored = rule_states[rule.id];
+    stored = state;
+    schedule(stored, after);
+
+    return true;
+}
+
+void HueScheduler::removeRule(QString id)
+{
+    /* its wheel entry is dropped when its slot comes */
+    rule_states.remove(id);
+}
+
+QList<HueScheduleRule> HueScheduler::rules()
+{
+    QList<HueScheduleRule> list;
+
+    for (const RuleState &state : std::as_const(rule_states)) {
+        list.append(state.rule);
+    }
+
+    return list;
+}
+
+QDateTime HueScheduler::nextRun(QString id)
+{
+    return rule_states.value(id).next_run;
+}
+
+QDateTime HueScheduler::computeNextRun(const RuleState &state, const QDateTime &after)
+{
+    if (state.rule.trigger == schedule_cron) {
+        return hueCronNext(state.cron, after);
+    }
+
+    if (!has_location) {
+        return QDateTime();
+    }
+
+    /* the day before too, a large negative offset may move its event past after */
+    QDate date = after.toUTC().date().addDays(-1);
+
+    for (int d = 0; d <= 367; ++d) {
+        QDateTime event = hueSunEvent(date.addDays(d), location_latitude, location_longitude, state.rule.trigger == schedule_sunrise);
+
+        if (!event.isValid()) {
+            continue;
+        }
+
+        event = event.addSecs(state.rule.offset);
+        if (event > after) {
+            return event;
+        }
+    }
+
+    return QDateTime();
+}
+
+QDateTime HueScheduler::latestMissedRun(const RuleState &state, const QDateTime &oldest, const QDateTime &now)
+{
+    QDateTime latest = oldest;
+
+    /* runs older than the limit are never caught up, start the walk at it */
+    QDateTime window = now.addSecs(-state.rule.catch_up_limit);
+    if (latest < window) {
+        QDateTime first = computeNextRun(state, window.addSecs(-1));
+
+        if (!first.isValid() || first > now) {
+            return latest;
+        }
+
+        latest = first;
+    }
+
+    QDateTime next = computeNextRun(state, latest);
+    while (next.isValid() && next <= now) {
+        latest = next;
+        next = computeNextRun(state, latest);
+    }
+
+    return latest;
+}
+
+void HueScheduler::schedule(RuleState &state, const QDateTime &after)
+{
+    state.generation = ++last_generation;
+    state.next_run = computeNextRun(state, after);
+
+    if (!state.rule.enabled || !state.next_run.isValid()) {
+        return;
+    }
+
+    WheelEntry entry;
+    entry.id = state.rule.id;
+    entry.due_tick = (state.next_run.toMSecsSinceEpoch() + tick_msec - 1) / tick_msec;
+    entry.generation = state.generation;
+
+    /* a run already due goes to the next tick, keeping its time for the catch-up check */
+    qint64 slot_tick = qMax(entry.due_tick, current_tick + 1);
+    wheel[slot_tick % wheel_slots].append(entry);
+}
+
+void HueScheduler::rescheduleAll()
+{
+    QDateTime now = clock->now();
+
+    for (int i = 0; i < wheel.size(); ++i) {
+        wheel[i].clear();
+    }
+
+    for (RuleState &state : rule_states) {
+        schedule(state, now);
+    }
+}
+
+void HueScheduler::collectSlot(int slot, qint64 now_tick, QList<WheelEntry> &due)
+{
+    QList<WheelEntry> &entries = wheel[slot];
+
+    for (int i = entries.size() - 1; i >= 0; --i) {
+        const WheelEntry &entry = entries[i];
+        auto state = rule_states.constFind(entry.id);
+
+        if (state == rule_states.constEnd() || state->generation != entry.generation) {
+            entries.removeAt(i);
+        } else if (entry.due_tick <= now_tick) {
+            due.append(entry);
+            entries.removeAt(i);
+        }
+    }
+}
+
+void HueScheduler::advance()
+{
+    QDateTime now = clock->now();
+    qint64 now_tick = now.toMSecsSinceEpoch() / tick_msec;
+    QList<WheelEntry> due;
+
+    if (now_tick < current_tick) {
+        current_tick = now_tick;
+        rescheduleAll();
+        return;
+    }
+
+    if (now_tick == current_tick) {
+        return;
+    }
+
+    if (now_tick - current_tick >= wheel_slots) {
+        for (int slot = 0; slot < wheel_slots; ++slot) {
+            collectSlot(slot, now_tick, due);
+        }
+    } else {
+        for (qint64 tick = current_tick + 1; tick <= now_tick; ++tick) {
+            collectSlot(tick % wheel_slots, now_tick, due);
+        }
+    }
+
+    current_tick = now_tick;
+
+    if (due.isEmpty()) {
+        return;
+    }
+
+    QList<QPair<WheelEntry, QDateTime>> fired;
+    QList<QPair<WheelEntry, QDateTime>> skipped;
+    QList<QPair<QDateTime, HueScheduleRule>> runs;
+
+    for (const WheelEntry &entry : due) {
+        RuleState &state = rule_states[entry.id];
+        QDateTime scheduled = state.next_run;
+
+        bool missed = now_tick - entry.due_tick > late_grace;
+        if (missed) {
+            scheduled = latestMissedRun(state, scheduled, now);
+        }
+
+        if (missed && (!state.rule.catch_up || scheduled.secsTo(now) > state.rule.catch_up_limit)) {
+            skipped.append(qMakePair(entry, scheduled));
+        } else {
+            state.rule.last_run = scheduled;
+            runs.append(qMakePair(scheduled, state.rule));
+            fired.append(qMakePair(entry, scheduled));
+        }
+
+        /* of several missed runs only the latest one is caught up */
+        schedule(state, now);
+    }
+
+    /* applied in the order of their times, one batch per run of equal actions */
+    std::stable_sort(runs.begin(), runs.end(), [](const QPair<QDateTime, HueScheduleRule> &a, const QPair<QDateTime, HueScheduleRule> &b) {
+        return a.first < b.first;
+    });
+
+    QStringList targets;
+    for (int i = 0; i < runs.size(); ++i) {
+        const HueScheduleRule &rule = runs[i].second;
+        targets.append(rule.target);
+
+        if (i + 1 < runs.size() && runs[i + 1].second.action == rule.action) {
+            continue;
+        }
+
+        switch (rule.action) {
+            case schedule_recall_scene:
+                sink->recallScenes(targets);
+                break;
+            case schedule_switch_on:
+                sink->switchGroups(targets, true);
+                break;
+            case schedule_switch_off:
+                sink->switchGroups(targets, false);
+                break;
+        }
+
+        targets.clear();
+    }
+
+    /* emitted last, receivers may change the rules */
+    for (const auto &run : std::as_const(skipped)) {
+        emit ruleSkipped(run.first.id, run.second);
+    }
+
+    for (const auto &run : std::as_const(fired)) {
+        emit ruleFired(run.first.id, run.second);
+    }
+}
@@ -0,0 +1,315 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QtMath>
+
+#include "huesensor.h"
+
+HueSensorTypes hueSensorType(const QString &type)
+{
+    if (type == QLatin1String("motion"))
+        return sensor_motion;
+
+    if (type == QLatin1String("temperature"))
+        return sensor_temperature;
+
+    if (type == QLatin1String("light_level"))
+        return sensor_light_level;
+
+    if (type == QLatin1String("button"))
+        return sensor_button;
+
+    if (type == QLatin1String("device_power"))
+        return sensor_device_power;
+
+    return sensor_unknown;
+}
+
+QString hueSensorTypeName(HueSensorTypes type)
+{
+    switch (type) {
+        case sensor_motion: return "motion";
+        case sensor_temperature: return "temperature";
+        case sensor_light_level: return "light_level";
+        case sensor_button: return "button";
+        case sensor_device_power: return "device_power";
+        default: return "";
+    }
+}
+
+QStringList hueSensorTypeNames(QList<HueSensorTypes> types)
+{
+    QStringList names;
+
+    if (types.isEmpty()) {
+        types << sensor_motion << sensor_temperature << sensor_light_level << sensor_button << sensor_device_power;
+    }
+
+    for (HueSensorTypes type : types) {
+        names.append(hueSensorTypeName(type));
+    }
+
+    return names;
+}
+
+double hueLightLevelToLux(int light_level)
+{
+    return qPow(10.0, (light_level - 1) / 10000.0);
+}
+
+bool hueSensorUpdate(HueSensorState &state, const QJsonObject &json)
+{
+    bool changed = false;
+
+    if (json.contains("id")) {
+        state.id = json["id"].toString();
+    }
+
+    if (json.contains("type")) {
+        state.type = hueSensorType(json["type"].toString());
+    }
+
+    if (json.contains("owner")) {
+        state.owner = json["owner"].toObject()["rid"].toString();
+    }
+
+    if (json.contains("enabled")) {
+        changed |= state.enabled != json["enabled"].toBool();
+        state.enabled = json["enabled"].toBool();
+    }
+
+    // the *_report objects are newer and carry the time of the change
+    if (json.contains("motion")) {
+        QJsonObject motion = json["motion"].toObject();
+        bool value = motion.contains("motion_report") ?
+            motion["motion_report"].toObject()["motion"].toBool() : motion["motion"].toBool();
+
+        changed |= state.motion != value;
+        state.motion = value;
+    }
+
+    if (json.contains("temperature")) {
+        QJsonObject temperature = json["temperature"].toObject();
+        double value = temperature.contains("temperature_report") ?
+            temperature["temperature_report"].toObject()["temperature"].toDouble() : temperature["temperature"].toDouble();
+
+        changed |= !qFuzzyCompare(state.temperature + 1.0, value + 1.0);
+        state.temperature = value;
+    }
+
+    if (json.contains("light")) {
+        QJsonObject light = json["light"].toObject();
+        int value = light.contains("light_level_report") ?
+            light["light_level_report"].toObject()["light_level"].toInt() : light["light_level"].toInt();
+
+        changed |= state.light_level != value;
+        state.light_level = value;
+    }
+
+    if (json.contains("button")) {
+        QJsonObject button = json["button"].toObject();
+        QString value = button.contains("button_report") ?
+            button["button_report"].toObject()["event"].toString() : button["last_event"].toString();
+
+        // every press is news, even the same event twice
+        changed |= value != "";
+        state.button_event = value;
+    }
+
+    if (json.contains("power_state")) {
+        QJsonObject power = json["power_state"].toObject();
+
+        if (power.contains("battery_level")) {
+            changed |= state.battery_level != power["battery_level"].toInt();
+            state.battery_level = power["battery_level"].toInt();
+        }
+
+        if (power.contains("battery_state")) {
+            changed |= state.battery_state != power["battery_state"].toString();
+            state.battery_state = power["battery_state"].toString();
+        }
+    }
+
+    if (changed) {
+        state.changed = QDateTime::currentDateTimeUtc();
+    }
+
+    return changed;
+}
+
+HueSensorSubscription::HueSensorSubscription(QList<HueSensorTypes> sensor_types, QStringList sensor_rids, HueBridge *bridge, QObject *parent): QObject(parent)
+{
+    filter_types = sensor_types;
+    filter_rids = sensor_rids;
+
+    /* a child, the bridge drops it from its index when this is destroyed */
+    events = bridge->subscribe(hueSensorTypeNames(sensor_types), sensor_rids, this);
+}
+
+QList<HueSensorTypes> HueSensorSubscription::types()
+{
+    return filter_types;
+}
+
+QStringList HueSensorSubscription::rids()
+{
+    return filter_rids;
+}
+
+bool HueSensorSubscription::matches(const HueSensorState &state)
+{
+    if (!filter_types.isEmpty() && !filter_types.contains(state.type)) {
+        return false;
+    }
+
+    if (!filter_rids.isEmpty() && !filter_rids.contains(state.id)) {
+        return false;
+    }
+
+    return true;
+}
+
+HueSensors::HueSensors(HueBridge *hue_bridge, QObject *parent): QObject(parent)
+{
+    bridge = hue_bridge;
+
+    connect(bridge, SIGNAL(resourceV2(QString, QJsonObject)), this, SLOT(readResource(QString, QJsonObject)));
+
+    events = bridge->subscribe(hueSensorTypeNames(), QStringList(), this);
+    connect(events, SIGNAL(received(HueEvent)), this, SLOT(readEvent(HueEvent)));
+}
+
+void HueSensors::load()
+{
+    QStringList types = hueSensorTypeNames();
+
+    /* only the sensor types, a full status would rebuild every bridge widget */
+    loading_types = QSet<QString>(types.begin(), types.end());
+    bridge->getResources(types);
+}
+
+HueSensorSubscription *HueSensors::subscribe(QList<HueSensorTypes> types, QStringList rids)
+{
+    return new HueSensorSubscription(types, rids, bridge, this);
+}
+
+void HueSensors::unsubscribe(HueSensorSubscription *subscription)
+{
+    subscription->deleteLater();
+}
+
+QList<HueSensorState> HueSensors::sensors(HueSensorTypes type)
+{
+    QList<HueSensorState> list;
+
+    for (const HueSensorState &state : sensor_states) {
+        if (type == sensor_unknown || state.type == type) {
+            list.append(state);
+        }
+    }
+
+    return list;
+}
+
+HueSensorState HueSensors::sensor(QString id)
+{
+    return sensor_states.value(id);
+}
+
+QList<HueSensorSubscription*> HueSensors::subscribers(const QString &id, HueSensorTypes type)
+{
+    QList<HueSensorSubscription*> list;
+
+    for (HueEventSubscription *subscription : bridge->subscribers(id, hueSensorTypeName(type))) {
+        HueSensorSubscription *sensor_subscription = qobject_cast<HueSensorSubscription*>(subscription->parent());
+
+        if (sensor_subscription != nullptr) {
+            list.append(sensor_subscription);
+        }
+    }
+
+    return list;
+}
+
+void HueSensors::updateSensor(const QJsonObject &json, HueSensorTypes type, bool notify)
+{
+    QString id = json["id"].toString();
+
+    if (id == "") {
+        return;
+    }
+
+    HueSensorState &state = sensor_states[id];
+    state.type = type;
+
+    bool changed = hueSensorUpdate(state, json);
+
+    if (!notify || !changed) {
+        return;
+    }
+
+    for (HueSensorSubscription *subscription : subscribers(id, type)) {
+        if (subscription->matches(state)) {
+            emit subscription->sensorChanged(state);
+        }
+    }
+}
+
+void HueSensors::removeSensor(const QString &id)
+{
+    if (!sensor_states.contains(id)) {
+        return;
+    }
+
+    HueSensorState state = sensor_states.take(id);
+
+    for (HueSensorSubscription *subscription : subscribers(id, state.type)) {
+        if (subscription->matches(state)) {
+            emit subscription->sensorRemoved(id);
+        }
+    }
+}
+
+void HueSensors::readResource(QString type, QJsonObject json)
+{
+    HueSensorTypes sensor_type = hueSensorType(type);
+
+    if (sensor_type == sensor_unknown) {
+        return;
+    }
+
+    QJsonArray json_array = json["data"].toArray();
+
+    for (int i = 0; i < json_array.size(); ++i) {
+        updateSensor(json_array[i].toObject(), sensor_type, false);
+    }
+
+    if (loading_types.remove(type) && loading_types.isEmpty()) {
+        emit sensorsLoaded();
+    }
+}
+
+void HueSensors::readEvent(const HueEvent &event)
+{
+    HueSensorTypes type = hueSensorType(event.type);
+
+    if (event.event == event_delete) {
+        removeSensor(event.id);
+    } else {
+        updateSensor(event.data, type, true);
+    }
+}
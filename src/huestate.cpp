@@ -0,0 +1,141 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "hueevent.h"
+#include "huestate.h"
+
+QJsonObject HueSnapshot::resource(const QString &id) const
+{
+    return resources.value(types.value(id)).value(id);
+}
+
+QList<QJsonObject> HueSnapshot::resourcesOfType(const QString &type) const
+{
+    return resources.value(type).values();
+}
+
+HueStateStore::HueStateStore()
+{
+    current.store(std::make_shared<const HueSnapshot>());
+}
+
+std::shared_ptr<const HueSnapshot> HueStateStore::snapshot() const
+{
+    return current.load(std::memory_order_acquire);
+}
+
+void HueStateStore::insertResource(HueSnapshot &next, const QJsonObject &resource)
+{
+    QString id = resource["id"].toString();
+
+    if (id == "") {
+        return;
+    }
+
+    QString type = resource["type"].toString();
+
+    /* a rid keeps its type, only a changed one touches the rid index */
+    if (next.types.value(id) != type) {
+        removeResource(next, id);
+        next.types[id] = type;
+    }
+
+    next.resources[type][id] = resource;
+}
+
+void HueStateStore::removeResource(HueSnapshot &next, const QString &id)
+{
+    if (!next.types.contains(id)) {
+        return;
+    }
+
+    next.resources[next.types.take(id)].remove(id);
+}
+
+quint64 HueStateStore::publish(HueSnapshot &next)
+{
+    next.version++;
+
+    quint64 version = next.version;
+    current.store(std::make_shared<const HueSnapshot>(std::move(next)), std::memory_order_release);
+
+    return version;
+}
+
+quint64 HueStateStore::replaceAll(const QJsonArray &data)
+{
+    HueSnapshot next;
+    next.version = snapshot()->version;
+
+    for (int i = 0; i < data.size(); ++i) {
+        insertResource(next, data[i].toObject());
+    }
+
+    return publish(next);
+}
+
+quint64 HueStateStore::replaceType(const QString &type, const QJsonArray &data)
+{
+    HueSnapshot next = *snapshot();
+
+    for (const QString &id : next.resources.take(type).keys()) {
+        next.types.remove(id);
+    }
+
+    for (int i = 0; i < data.size(); ++i) {
+        insertResource(next, data[i].toObject());
+    }
+
+    return publish(next);
+}
+
+quint64 HueStateStore::upsert(const QJsonArray &data)
+{
+    HueSnapshot next = *snapshot();
+
+    for (int i = 0; i < data.size(); ++i) {
+        insertResource(next, data[i].toObject());
+    }
+
+    return publish(next);
+}
+
+quint64 HueStateStore::applyEvents(const QJsonArray &containers)
+{
+    HueSnapshot next = *snapshot();
+
+    for (int i = 0; i < containers.size(); ++i) {
+        QJsonObject container = containers[i].toObject();
+        HueEventTypes event_type = hueEventType(container["type"].toString());
+        QJsonArray data = container["data"].toArray();
+
+        for (int j = 0; j < data.size(); ++j) {
+            QJsonObject item = data[j].toObject();
+            QString id = item["id"].toString();
+
+            if (event_type == event_add) {
+                insertResource(next, item);
+            } else if (event_type == event_delete) {
+                removeResource(next, id);
+            } else if (event_type == event_update && next.types.contains(id)) {
+                hueMergeUpdate(next.resources[next.types.value(id)][id], item);
+            }
+        }
+    }
+
+    return publish(next);
+}
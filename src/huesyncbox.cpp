@@ -20,8 +20,12 @@
 #include <QJsonObject>
 #include <QVariant>
 #include <QHostInfo>
+#include <QPointer>
 
+#include "hueasync.h"
 #include "hueutils.h"
+#include "huejson.h"
+#include "huetracer.h"
 #include "huesyncbox.h"
 
 const QByteArray pem_cert("-----BEGIN CERTIFICATE-----\n\
@@ -37,6 +41,20 @@ IAFDI0Q4IOPxV7cY4wSVOJAn4y5AdZwrItJ1XuNpmCltAiEA5c6wcu6qmF596uyA\n\
 r7xLnr3/F5zJxrE3AyLD4t+5oKs=\n\
 -----END CERTIFICATE-----");
 
+/* the syncbox nests its settings deeper than bridge events, merge every level */
+static void mergeNested(QJsonObject &target, const QJsonObject &update)
+{
+    for (auto i = update.constBegin(); i != update.constEnd(); ++i) {
+        if (i.value().isObject() && target[i.key()].isObject()) {
+            QJsonObject merged = target[i.key()].toObject();
+            mergeNested(merged, i.value().toObject());
+            target[i.key()] = merged;
+        } else {
+            target[i.key()] = i.value();
+        }
+    }
+}
+
 HueSyncbox::HueSyncbox(QString ip, HueDevice *parent): HueDevice(ip, parent)
 {
     QList<QSslCertificate> ca_certificates;
@@ -44,14 +62,28 @@ HueSyncbox::HueSyncbox(QString ip, HueDevice *parent): HueDevice(ip, parent)
     ssl_configuration.setCaCertificates(ca_certificates);
 
     connect(this, SIGNAL(requestDeviceFinished(const QVariant, const QString)), this, SLOT(syncboxRequestFinished(const QVariant, const QString)));
+    connect(this, SIGNAL(requestDeviceFailed(const QVariant)), this, SLOT(syncboxRequestFailed(const QVariant)));
+
+    refresh_timer = new QTimer(this);
+    refresh_timer->setSingleShot(true);
+    refresh_timer->setInterval(refresh_delay);
+    connect(refresh_timer, &QTimer::timeout, this, &HueSyncbox::getExecution);
+
+    poll_timer = new QTimer(this);
+    connect(poll_timer, SIGNAL(timeout()), this, SLOT(poll()));
+
+    brightness_timer = new QTimer(this);
+    brightness_timer->setSingleShot(true);
+    brightness_timer->setInterval(brightness_interval);
+    connect(brightness_timer, SIGNAL(timeout()), this, SLOT(sendBrightness()));
 }
 
 void HueSyncbox::setAccessToken(QString s)
 {
     access_token = s;
 
-    request_headers.clear();
-    request_headers.append(createHeader("Authorization", "Bearer " + access_token));
+    clearRequestHeaders();
+    setRequestHeader("Authorization", "Bearer " + access_token);
 
     setKnown();
 }
@@ -83,6 +115,13 @@ bool HueSyncbox::updateSyncboxInfo(QJsonObject data)
         }
     }
 
+    if (data.contains("mdnsName")) {
+        if (mdnsName() != data["mdnsName"].toString()) {
+            setMdnsName(data["mdnsName"].toString());
+            changed = true;
+        }
+    }
+
     if (data.contains("accessToken")) {
         if (access_token != data["accessToken"].toString()) {
             setAccessToken(data["accessToken"].toString());
@@ -108,6 +147,7 @@ QJsonObject HueSyncbox::dumpSyncbox()
     json["uniqueId"] = id();
     json["name"] = deviceName();
     json["ipAddress"] = ip();
+    json["mdnsName"] = mdnsName();
     json["accessToken"] = access_token;
     json["registrationId"] = registration_id;
 
@@ -116,40 +156,46 @@ QJsonObject HueSyncbox::dumpSyncbox()
 
 void HueSyncbox::createRegistration()
 {
-    registration_counter = 0;
-
-    registration_timer = new QTimer(this);
+    if (registering || known()) {
+        return;
+    }
 
-    tryRegister();
+    runRegistration();
 }
 
-void HueSyncbox::tryRegister()
+HueTask<void> HueSyncbox::runRegistration()
 {
-    registration_counter++;
+    QPointer<HueSyncbox> syncbox = this;
+    registering = true;
 
-    if (known()) {
-        return;
+    /* each reply is read by readRegistration, this only retries */
+    bool ok = co_await hueRegisterSyncbox(this);
+
+    if (syncbox.isNull()) {
+        co_return;
     }
 
-    if (registration_counter > 8) {
+    registering = false;
+
+    if (!ok) {
         emit registrationFailed();
-        return;
     }
+}
 
+quint64 HueSyncbox::postRegistration()
+{
     QString host_name = QHostInfo::localHostName().left(10);
 
     QJsonObject json;
     json["appName"] = "hue-qt";
     json["instanceName"] = host_name;
 
-    QString url = url_api_v1.arg(ip(), "registrations");
+    QUrl url = deviceUrl(path_api_v1 + "registrations");
 
     QJsonDocument doc(json);
-    QByteArray bytes = doc.toJson();
+    QByteArray bytes = doc.toJson(QJsonDocument::Compact);
 
-    sendRequestPOST(url, (QNetworkRequest::Attribute) req_registration, bytes);
-
-    registration_timer->singleShot(3000, this, SLOT(tryRegister()));
+    return sendRequestPOST(url, (QNetworkRequest::Attribute) req_registration, bytes);
 }
 
 void HueSyncbox::syncboxRequestFinished(const QVariant type, const QString ret)
@@ -165,8 +211,7 @@ void HueSyncbox::syncboxRequestFinished(const QVariant type, const QString ret)
 
         case req_device:
             {
-                QString device_status = ret;
-                QJsonObject json = QString2QJsonObject(device_status);
+                QJsonObject json = requestJson().object();
                 if (updateSyncboxInfo(json)) {
                     emit infoUpdated();
                 }
@@ -175,16 +220,58 @@ void HueSyncbox::syncboxRequestFinished(const QVariant type, const QString ret)
 
         case req_syncbox_status:
             {
-                QString device_status = ret;
-                QJsonObject json = QString2QJsonObject(device_status);
+                QJsonObject json = requestJson().object();
+                status_cache = json;
                 emit status(json);
                 break;
             }
 
+        case req_syncbox_execution:
+            {
+                mergeStatus("execution", requestJson().object());
+                break;
+            }
+
+        case req_syncbox_hdmi:
+            {
+                mergeStatus("hdmi", requestJson().object());
+                break;
+            }
+
         case req_syncbox_put_execution:
             {
+                /* replies may overtake each other, the serial pairs them with their body */
+                HueSyncboxExecution execution = pending_executions.take(requestSerial());
+                QJsonObject json = execution.json;
+                if (execution.key != nullptr) {
+                    json[QString::fromLatin1(execution.key)] = execution.value;
+                }
+
+                mergeNested(json, requestJson().object());
+                mergeStatus("execution", json);
+
+                /* one partial refresh after a burst of changes picks up the derived values */
+                refresh_timer->start();
+
+                emit executionFinished();
+                break;
+            }
+
+        case req_syncbox_put_brightness:
+            {
+                brightness_in_flight = false;
+
+                QJsonObject json;
+                json["brightness"] = brightness_sent;
+                mergeStatus("execution", json);
+
                 emit executionFinished();
+
+                /* the ack paces the next value */
+                sendBrightness();
+                break;
             }
+
         default:
             {
                 break;
@@ -192,6 +279,38 @@ void HueSyncbox::syncboxRequestFinished(const QVariant type, const QString ret)
     }
 }
 
+void HueSyncbox::syncboxRequestFailed(const QVariant type)
+{
+    HueSyncboxRequestTypes hue_type = (HueSyncboxRequestTypes) type.toInt();
+
+    if (hue_type == req_syncbox_put_execution) {
+        pending_executions.remove(requestSerial());
+
+        refresh_timer->start();
+    }
+
+    if (hue_type == req_syncbox_put_brightness) {
+        brightness_in_flight = false;
+        sendBrightness();
+    }
+}
+
+void HueSyncbox::mergeStatus(QString section, QJsonObject json)
+{
+    /* nothing to merge into before the first full status */
+    if (status_cache.isEmpty() || json.isEmpty()) {
+        return;
+    }
+
+    QJsonObject json_section = status_cache[section].toObject();
+    mergeNested(json_section, json);
+    status_cache[section] = json_section;
+
+    QJsonObject delta;
+    delta[section] = json_section;
+    emit status(delta);
+}
+
 void HueSyncbox::readRegistration(QString ret)
 {
     QJsonObject json = QString2QJsonObject(ret);
@@ -205,26 +324,78 @@ void HueSyncbox::readRegistration(QString ret)
     }
 }
 
-void HueSyncbox::getDevice()
+quint64 HueSyncbox::getDevice()
+{
+    QUrl url = deviceUrl(path_api_v1 + "device");
+
+    return sendRequestGET(url, (QNetworkRequest::Attribute) req_device);
+}
+
+quint64 HueSyncbox::getStatus()
+{
+    QUrl url = deviceUrl(path_api_v1);
+
+    return sendRequestGET(url, (QNetworkRequest::Attribute) req_syncbox_status);
+}
+
+quint64 HueSyncbox::getExecution()
 {
-    QString url = url_api_v1.arg(ip(), "device");
+    QUrl url = deviceUrl(path_api_v1 + "execution");
 
-    sendRequestGET(url, (QNetworkRequest::Attribute) req_device);
+    return sendRequestGET(url, (QNetworkRequest::Attribute) req_syncbox_execution);
 }
 
-void HueSyncbox::getStatus()
+quint64 HueSyncbox::getHdmi()
 {
-    QString url = url_api_v1.arg(ip(), "");
+    QUrl url = deviceUrl(path_api_v1 + "hdmi");
 
-    sendRequestGET(url, (QNetworkRequest::Attribute) req_syncbox_status);
+    return sendRequestGET(url, (QNetworkRequest::Attribute) req_syncbox_hdmi);
 }
 
-void HueSyncbox::setExecution(QJsonObject json)
+void HueSyncbox::setPollInterval(int msec)
 {
-    QString url = url_api_v1.arg(ip(), "execution");
+    if (msec <= 0) {
+        poll_timer->stop();
+        return;
+    }
+
+    poll_timer->start(msec);
+}
+
+void HueSyncbox::poll()
+{
+    getExecution();
+    getHdmi();
+}
+
+quint64 HueSyncbox::setExecution(QJsonObject json)
+{
+    QUrl url = deviceUrl(path_api_v1 + "execution");
     QJsonDocument doc(json);
-    QByteArray data = doc.toJson();
-    sendRequestPUT(url, (QNetworkRequest::Attribute) req_syncbox_put_execution, data);
+    QByteArray data = doc.toJson(QJsonDocument::Compact);
+
+    HueSyncboxExecution execution;
+    execution.json = json;
+
+    quint64 serial = sendRequestPUT(url, (QNetworkRequest::Attribute) req_syncbox_put_execution, data);
+    pending_executions.insert(serial, execution);
+
+    return serial;
+}
+
+void HueSyncbox::putExecution(const char *key, QJsonValue value)
+{
+    HueJsonWriter writer(48);
+    writer.beginObject().value(key, value).endObject();
+
+    /* keys are literals, the value is merged into the status once acknowledged */
+    HueSyncboxExecution execution;
+    execution.key = key;
+    execution.value = value;
+
+    QUrl url = deviceUrl(path_api_v1 + "execution");
+    quint64 serial = sendRequestPUT(url, (QNetworkRequest::Attribute) req_syncbox_put_execution, writer.take());
+    pending_executions.insert(serial, execution);
 }
 
 void HueSyncbox::setPower(bool on)
@@ -239,42 +410,63 @@ void HueSyncbox::setPower(bool on)
 
 void HueSyncbox::setSync(bool on)
 {
-    QJsonObject json;
-    json["syncActive"] = on;
-    setExecution(json);
+    putExecution("syncActive", on);
 }
 
 void HueSyncbox::setMode(QString mode)
 {
-    QJsonObject json;
-    json["mode"] = mode;
-    setExecution(json);
+    putExecution("mode", mode);
 }
 
 void HueSyncbox::setIntensity(QString intensity)
 {
-    QJsonObject json;
-    json["intensity"] = intensity;
-    setExecution(json);
+    putExecution("intensity", intensity);
 }
 
 void HueSyncbox::setBrightness(int brightness)
 {
-    QJsonObject json;
-    json["brightness"] = brightness;
-    setExecution(json);
+    putExecution("brightness", brightness);
+}
+
+void HueSyncbox::streamBrightness(int brightness)
+{
+    /* a newer value replaces the one still waiting */
+    if (brightness_pending >= 0 && brightness_trace != 0) {
+        HueTracer::instance()->drop(brightness_trace);
+    }
+
+    brightness_pending = brightness;
+    brightness_trace = HueTracer::current();
+    sendBrightness();
+}
+
+void HueSyncbox::sendBrightness()
+{
+    if (brightness_pending < 0 || brightness_in_flight || brightness_timer->isActive()) {
+        return;
+    }
+
+    brightness_sent = brightness_pending;
+    brightness_pending = -1;
+    brightness_in_flight = true;
+    brightness_timer->start();
+
+    HueJsonWriter writer(32);
+    writer.beginObject().value("brightness", brightness_sent).endObject();
+
+    HueTraceScope trace(brightness_trace);
+    brightness_trace = 0;
+
+    QUrl url = deviceUrl(path_api_v1 + "execution");
+    sendRequestPUT(url, (QNetworkRequest::Attribute) req_syncbox_put_brightness, writer.take());
 }
 
 void HueSyncbox::setInput(QString input)
 {
-    QJsonObject json;
-    json["hdmiSource"] = input;
-    setExecution(json);
+    putExecution("hdmiSource", input);
 }
 
 void HueSyncbox::setGroup(QString groupid)
 {
-    QJsonObject json;
-    json["hueTarget"] = groupid;
-    setExecution(json);
+    putExecution("hueTarget", groupid);
 }
\ No newline at end of file
@@ -0,0 +1,144 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QVariant>
+
+#include "hueutils.h"
+#include "huesyncbox.h"
+
+HueSyncboxDiscovery::HueSyncboxDiscovery(QObject *parent): QObject(parent)
+{
+    manager = new QNetworkAccessManager();
+
+    connect(manager, SIGNAL(sslErrors(QNetworkReply*,QList<QSslError>)), this, SLOT(onSslError(QNetworkReply*, QList<QSslError>)));
+    connect(manager, SIGNAL(finished(QNetworkReply*)), this, SLOT(requestFinished(QNetworkReply*)));
+
+    mdns = new HueMdnsBrowser(this);
+    connect(mdns, SIGNAL(serviceResolved(QString, QString, quint16, QJsonObject)), this, SLOT(mdnsResolved(QString, QString, quint16, QJsonObject)));
+}
+
+void HueSyncboxDiscovery::onSslError(QNetworkReply* r, QList<QSslError> l)
+{
+    HueSyncboxRequestTypes hue_type = (HueSyncboxRequestTypes) r->request().attribute(HUEREQUEST_TYPE).toInt();
+
+    if (hue_type != req_discovery_syncbox) {
+        return;
+    }
+
+    /*
+     the uniqueId used as the peer name is not known before the probe and
+     the syncbox ca is not trusted here, any other error fails the probe
+    */
+    for (const QSslError &error : l) {
+        switch (error.error()) {
+            case QSslError::SelfSignedCertificate:
+            case QSslError::SelfSignedCertificateInChain:
+            case QSslError::UnableToGetLocalIssuerCertificate:
+            case QSslError::UnableToVerifyFirstCertificate:
+            case QSslError::HostNameMismatch:
+                break;
+
+            default:
+                qWarning() << "syncbox probe ssl error: " + error.errorString();
+                return;
+        }
+    }
+
+    r->ignoreSslErrors(l);
+}
+
+void HueSyncboxDiscovery::requestFinished(QNetworkReply *reply)
+{
+    reply->deleteLater();
+
+    if (reply->error()) {
+        qWarning() << "request reply - failed to discover syncbox";
+        return;
+    }
+
+    QString ret = reply->readAll();
+
+    QNetworkRequest request = reply->request();
+
+    HueSyncboxRequestTypes hue_type = (HueSyncboxRequestTypes) request.attribute(HUEREQUEST_TYPE).toInt();
+
+    if (hue_type == req_discovery_syncbox) {
+        QJsonObject object_data = QString2QJsonObject(ret);
+        QString ip = request.attribute(HUEREQUEST_IP).toString();
+        readSyncbox(object_data, ip);
+    }
+}
+
+void HueSyncboxDiscovery::discoverSyncboxes()
+{
+    probed_ips.clear();
+    discovered_ids.clear();
+
+    mdns->browse(mdns_service);
+}
+
+void HueSyncboxDiscovery::discoverSyncbox(QString ip)
+{
+    if (probed_ips.contains(ip)) {
+        return;
+    }
+
+    probed_ips.insert(ip);
+
+    QNetworkRequest request;
+    QString url = QString("https://%1/api/v1/device").arg(ip);
+
+    request.setUrl(QUrl(url));
+    request.setTransferTimeout(probe_timeout);
+    request.setAttribute(HUEREQUEST_TYPE, req_discovery_syncbox);
+    request.setAttribute(HUEREQUEST_IP, ip);
+    manager->get(request);
+}
+
+void HueSyncboxDiscovery::mdnsResolved(QString name, QString ip, quint16 port, QJsonObject txt)
+{
+    (void) port;
+    (void) txt;
+
+    /* every announcement is probed right away, the probes run concurrently */
+    mdns_names[ip] = name;
+    discoverSyncbox(ip);
+}
+
+void HueSyncboxDiscovery::readSyncbox(QJsonObject &data, QString ip)
+{
+    if (!data.contains("uniqueId") ||
+        !data["uniqueId"].isString()) {
+
+        return;
+    }
+
+    QString id = data["uniqueId"].toString();
+
+    if (discovered_ids.contains(id)) {
+        return;
+    }
+
+    discovered_ids.insert(id);
+
+    if (mdns_names.contains(ip)) {
+        data["mdnsName"] = mdns_names[ip];
+    }
+
+    emit syncboxDiscovered(data, ip);
+}
@@ -27,21 +27,7 @@ HueSyncboxList::HueSyncboxList(HueList *parent): HueList(parent)
 
 HueSyncbox* HueSyncboxList::findSyncbox(QString s)
 {
-    if (s == "") {
-        return NULL;
-    }
-
-    foreach(HueSyncbox *syncbox, list) {
-        if (syncbox->id() == s) {
-            return syncbox;
-        }
-
-        if (syncbox->ip() == s) {
-            return syncbox;
-        }
-    }
-
-    return NULL;
+    return static_cast<HueSyncbox*>(findDevice(s));
 }
 
 HueSyncbox* HueSyncboxList::addSyncbox(QString ip)
@@ -58,6 +44,7 @@ HueSyncbox* HueSyncboxList::addSyncbox(QString ip)
     connect(syncbox, SIGNAL(infoUpdated()), this, SLOT(needSave()));
 
     list.append(syncbox);
+    indexDevice(syncbox);
 
     return syncbox;
 }
@@ -71,6 +58,7 @@ bool HueSyncboxList::removeSyncbox(QString id)
     }
 
     list.removeOne(syncbox);
+    unindexDevice(syncbox);
     needSave();
 
     return true;
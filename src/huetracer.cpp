@@ -0,0 +1,238 @@
+/* Hue-QT - Application for controlling Philips Hue Bridge and HDMI Syncbox
+ * Copyright (C) 2021 Václav Chlumský
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QStringList>
+
+#include "huetracer.h"
+
+static thread_local quint64 current_trace = 0;
+
+HueTracer::HueTracer(QObject *parent): QObject(parent)
+{
+    clock.start();
+}
+
+HueTracer *HueTracer::instance()
+{
+    static HueTracer tracer;
+    return &tracer;
+}
+
+qint64 HueTracer::now()
+{
+    return clock.nsecsElapsed() / 1000;
+}
+
+quint64 HueTracer::current()
+{
+    return current_trace;
+}
+
+void HueTracer::setCurrent(quint64 trace)
+{
+    current_trace = trace;
+}
+
+quint64 HueTracer::begin(const QString &name, const QStringList &targets)
+{
+    QMutexLocker locker(&mutex);
+
+    qint64 start_us = now();
+
+    /* lost events must not keep traces open forever */
+    QList<quint64> expired;
+    for (auto i = open_traces.constBegin(); i != open_traces.constEnd(); ++i) {
+        if (start_us - i.value().start_us > trace_timeout_us) {
+            expired.append(i.key());
+        }
+    }
+
+    for (quint64 trace : expired) {
+        closeTrace(trace, start_us, "timeout");
+    }
+
+    HueTrace trace;
+    trace.name = name;
+    trace.start_us = start_us;
+
+    for (const QString &target : targets) {
+        trace.targets.insert(target);
+    }
+
+    open_traces[++last_trace] = trace;
+
+    return last_trace;
+}
+
+void HueTracer::addSpan(quint64 trace, const QString &name, qint64 start_us, qint64 end_us, QJsonObject args)
+{
+    QJsonObject span;
+    span["name"] = name;
+    span["cat"] = "hue";
+    span["ph"] = "X";
+    span["ts"] = start_us;
+    span["dur"] = qMax(Q_INT64_C(0), end_us - start_us);
+    span["pid"] = 1;
+    span["tid"] = (qint64) trace;
+    span["args"] = args;
+
+    spans.append(span);
+
+    while (spans.size() > spans_max) {
+        spans.removeFirst();
+    }
+}
+
+void HueTracer::closeTrace(quint64 trace, qint64 end_us, QString result)
+{
+    HueTrace closed = open_traces.take(trace);
+
+    if (result == "done" && closed.reply_us > 0) {
+        addSpan(trace, "event", closed.reply_us, end_us);
+    }
+
+    QJsonObject args;
+    args["requests"] = closed.requests;
+    args["result"] = result;
+    args["targets"] = QJsonArray::fromStringList(QStringList(closed.targets.begin(), closed.targets.end()));
+
+    addSpan(trace, closed.name, closed.start_us, end_us, args);
+}
+
+void HueTracer::requestSent(quint64 trace, const QString &endpoint)
+{
+    QMutexLocker locker(&mutex);
+
+    if (!open_traces.contains(trace)) {
+        return;
+    }
+
+    HueTrace &open = open_traces[trace];
+    open.requests++;
+
+    QJsonObject args;
+    args["endpoint"] = endpoint;
+
+    addSpan(trace, "queue", open.start_us, now(), args);
+}
+
+void HueTracer::requestFinished(quint64 trace, const QString &endpoint, qint64 sent_us, bool ok)
+{
+    QMutexLocker locker(&mutex);
+
+    if (!open_traces.contains(trace)) {
+        return;
+    }
+
+    qint64 reply_us = now();
+    open_traces[trace].reply_us = reply_us;
+
+    QJsonObject args;
+    args["endpoint"] = endpoint;
+    args["ok"] = ok;
+
+    addSpan(trace, "http", sent_us, reply_us, args);
+}
+
+void HueTracer::resourceUpdated(const QString &rid)
+{
+    QMutexLocker locker(&mutex);
+
+    QList<quint64> finished;
+    for (auto i = open_traces.begin(); i != open_traces.end(); ++i) {
+        if (i.value().targets.remove(rid) && i.value().targets.isEmpty()) {
+            finished.append(i.key());
+        }
+    }
+
+    qint64 end_us = now();
+    for (quint64 trace : finished) {
+        closeTrace(trace, end_us, "done");
+    }
+}
+
+void HueTracer::cancelTarget(quint64 trace, const QString &rid)
+{
+    QMutexLocker locker(&mutex);
+
+    if (!open_traces.contains(trace)) {
+        return;
+    }
+
+    HueTrace &open = open_traces[trace];
+    open.targets.remove(rid);
+
+    if (open.targets.isEmpty()) {
+        closeTrace(trace, now(), open.requests > 0 ? "done" : "coalesced");
+    }
+}
+
+void HueTracer::drop(quint64 trace)
+{
+    QMutexLocker locker(&mutex);
+
+    if (open_traces.contains(trace)) {
+        closeTrace(trace, now(), "coalesced");
+    }
+}
+
+QJsonObject HueTracer::chromeTrace()
+{
+    QMutexLocker locker(&mutex);
+
+    QJsonArray events;
+    for (const QJsonObject &span : spans) {
+        events.append(span);
+    }
+
+    QJsonObject json;
+    json["traceEvents"] = events;
+    json["displayTimeUnit"] = "ms";
+
+    return json;
+}
+
+bool HueTracer::exportChromeTrace(const QString &path)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "unable to export trace: " + file.errorString();
+        return false;
+    }
+
+    QJsonDocument doc(chromeTrace());
+    file.write(doc.toJson(QJsonDocument::Compact));
+
+    return true;
+}
+
+HueTraceScope::HueTraceScope(quint64 trace)
+{
+    previous = HueTracer::current();
+    HueTracer::setCurrent(trace);
+}
+
+HueTraceScope::~HueTraceScope()
+{
+    HueTracer::setCurrent(previous);
+}
@@ -17,6 +17,7 @@
 
 #include <QDebug>
 #include <QJsonDocument>
+#include <QtMath>
 
 #include "hueutils.h"
 
@@ -56,4 +57,57 @@ QJsonObject QString2QJsonObject(QString &data)
     obj = doc.object();
 
     return obj;
+}
+
+static double gammaCorrection(double value)
+{
+    if (value > 0.04045) {
+        return qPow((value + 0.055) / (1.0 + 0.055), 2.4);
+    }
+
+    return value / 12.92;
+}
+
+void hueRgbToXY(double red, double green, double blue, double &x, double &y)
+{
+    red = gammaCorrection(red);
+    green = gammaCorrection(green);
+    blue = gammaCorrection(blue);
+
+    double X = red * 0.649926 + green * 0.103455 + blue * 0.197109;
+    double Y = red * 0.234327 + green * 0.743075 + blue * 0.022598;
+    double Z = red * 0.0000000 + green * 0.053077 + blue * 1.035763;
+
+    if (X + Y + Z == 0.0) {
+        x = 0.0;
+        y = 0.0;
+        return;
+    }
+
+    x = X / (X + Y + Z);
+    y = Y / (X + Y + Z);
+}
+
+QByteArray hueGradientBody(const float *xy, int points)
+{
+    QByteArray body;
+    body.reserve(48 + points * 48);
+
+    body.append("{\"on\":{\"on\":true},\"gradient\":{\"points\":[");
+
+    for (int i = 0; i < points; ++i) {
+        if (i > 0) {
+            body.append(',');
+        }
+
+        body.append("{\"color\":{\"xy\":{\"x\":");
+        body.append(QByteArray::number(xy[i * 2], 'f', 4));
+        body.append(",\"y\":");
+        body.append(QByteArray::number(xy[i * 2 + 1], 'f', 4));
+        body.append("}}}");
+    }
+
+    body.append("]}}");
+
+    return body;
 }
\ No newline at end of file
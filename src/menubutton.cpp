@@ -16,6 +16,7 @@
  */
 
 #include <QHBoxLayout>
+#include <QPainter>
 
 #include "menubutton.h"
 #include "menuutils.h"
@@ -182,6 +183,38 @@ void MenuButton::setColorsPoints(QVarLengthArray<QColor> colors)
     }
 }
 
+void MenuButton::setPreviewColors(QVarLengthArray<QColor> colors)
+{
+    if (colors.isEmpty()) {
+        if (preview != nullptr) {
+            preview->clear();
+        }
+        return;
+    }
+
+    if (preview == nullptr) {
+        preview = new QLabel(this);
+        layout()->addWidget(preview);
+    }
+
+    /* one overlapping dot per color, drawn once instead of an svg per dot */
+    int step = preview_dot_size * 3 / 4;
+    QPixmap pixmap((colors.length() - 1) * step + preview_dot_size + 2, preview_dot_size + 2);
+    pixmap.fill(Qt::transparent);
+
+    QPainter painter(&pixmap);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(QColor("#2E2E2E"), 1));
+
+    for (int i = 0; i < colors.length(); ++i) {
+        painter.setBrush(colors[i]);
+        painter.drawEllipse(1 + i * step, 1, preview_dot_size, preview_dot_size);
+    }
+
+    painter.end();
+    preview->setPixmap(pixmap);
+}
+
 void MenuButton::setSwitch(bool on)
 {
     if (!has_switch) {return;}
@@ -193,6 +226,9 @@ void MenuButton::setSlider(int value)
 {
     if (!has_slider) {return;}
 
+    /* do not fight the user while the slider is dragged */
+    if (slider->isSliderDown()) {return;}
+
     manual_set = true;
     slider->setValue(value);
     manual_set = false;
@@ -205,6 +241,13 @@ void MenuButton::setSliderMax(int value)
     slider->setRange(0, value);
 }
 
+void MenuButton::setSliderTracking(bool enable)
+{
+    if (!has_slider) {return;}
+
+    slider->setTracking(enable);
+}
+
 void MenuButton::setCombined(bool comb, bool all)
 {
     combined_state = comb;